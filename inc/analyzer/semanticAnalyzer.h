@@ -2,17 +2,34 @@
 #define SEMANTIC_ANALYZER_H
 
 #include "astVisitor.h"
+#include "staticVisitor.h"
 #include "symbolTable.h"
+#include "flatAst.h"
+#include <iostream>
+#include <vector>
 
-class SemanticAnalyzer : public ASTVisitor {
+class SemanticAnalyzer final : public ASTVisitor, public StaticASTVisitor<SemanticAnalyzer> {
 public:
-    SemanticAnalyzer() {
-        symbolTable = SymbolTable();
-    }
+    // Diagnostics go to errors
+    explicit SemanticAnalyzer(std::ostream& errors = std::cerr) : errors(&errors) {}
+    // Analyzer for a single function, seeing the first visibleGlobals
+    // globals of a module analyzer that has already run, without changing it
+    SemanticAnalyzer(const SemanticAnalyzer& module, uint32_t visibleGlobals, std::ostream& errors);
     ~SemanticAnalyzer() = default;
 
+    void setErrorStream(std::ostream& stream) { errors = &stream; }
+    uint32_t getGlobalCount() const { return symbolTable.getGlobalCount(); }
+
     void analyze(ASTNodePtr root);
 
+    // Re-checks a module after an incremental parse. Top-level lets are
+    // always visited to rebuild the global scope, of the functions only
+    // the given ones are, the rest were checked before and are unchanged.
+    void analyze(ModuleNode& module, const std::vector<FunctionNode*>& functions);
+
+    // Same checks over the flat representation
+    void analyze(FlatAST& ast);
+
     void visit(NumberNode& node) override;
     void visit(IdentifierNode& node) override;
     void visit(BinaryOperatorNode& node) override;
@@ -20,12 +37,15 @@ public:
     void visit(LetNode& node) override;
     void visit(FunctionNode& node) override;
     void visit(BooleanLiteralNode& node) override;
+    void visit(ModuleNode& node) override;
     // Implement other visit methods...
 
 private:
     SymbolTable symbolTable;
+    std::ostream* errors;
 
     void reportError(const std::string& message);
+    void analyzeFlat(FlatAST& ast, FlatNodeId node);
 };
 
 #endif // SEMANTIC_ANALYZER_H
\ No newline at end of file
@@ -2,7 +2,10 @@
 #define SYMBOL_TABLE_H
 
 #include <string>
-#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+#include "astNode.h"
+#include "stringInterner.h"
 
 enum class SymbolType {
     VARIABLE,
@@ -12,25 +15,63 @@ enum class SymbolType {
 
 struct SymbolInfo {
     SymbolType type;
-    std::string dataType;
+    Binding binding;
 };
 
+// Scoped symbol table in a single open-addressing hash table keyed by
+// SymbolId, each key pointing at its innermost binding. Declarations are
+// pushed onto a stack that doubles as the undo log: leaving a scope pops
+// the bindings made in it and points their names back at the ones they
+// shadowed, so entering and leaving costs O(declarations in the scope).
+//
+// Top-level declarations get global slots, everything inside a function
+// gets a slot in that function's frame, numbered from 0 per function.
 class SymbolTable {
 public:
-    SymbolTable() {
-        enterScope();
-    }
+    SymbolTable();
     ~SymbolTable() = default;
 
     void enterScope();
     void exitScope();
 
-    void insert(const std::string& name, SymbolType type, const std::string& dataType);
-    bool lookup(const std::string& name, SymbolInfo& info);
+    // Declares name in the innermost scope, throws if it already is
+    const SymbolInfo& insert(SymbolId name, SymbolType type, DataType dataType);
+    bool lookup(SymbolId name, SymbolInfo& info) const;
+
+    // Resolves names not declared here against the first visibleGlobals
+    // globals of another table, which must stay unchanged while in use.
+    // Lets several function bodies share one global scope read-only.
+    void setEnclosingGlobals(const SymbolTable* globals, uint32_t visibleGlobals);
+    uint32_t getGlobalCount() const { return globalSlots; }
 
 private:
-    std::unordered_map<std::string, SymbolInfo> currentScope;
-    std::vector<std::unordered_map<std::string, SymbolInfo>> scopeStack;
+    static constexpr uint32_t NoDeclaration = UINT32_MAX;
+
+    struct Entry {
+        SymbolId name = InvalidSymbol;
+        uint32_t declaration = NoDeclaration;  // innermost, NoDeclaration once out of scope
+    };
+
+    struct Declaration {
+        SymbolInfo info;
+        SymbolId name;
+        uint32_t depth;
+        uint32_t shadowed;  // declaration this one hides, if any
+    };
+
+    std::vector<Entry> entries;
+    size_t usedEntries = 0;
+    std::vector<Declaration> declarations;
+    // Size of declarations when each open scope was entered
+    std::vector<uint32_t> scopeMarks;
+    uint32_t globalSlots = 0;
+    uint32_t frameSlots = 0;
+    const SymbolTable* enclosing = nullptr;
+    uint32_t enclosingVisible = 0;
+
+    Entry& find(SymbolId name);
+    const Entry* find(SymbolId name) const;
+    void grow();
 };
 
-#endif
\ No newline at end of file
+#endif
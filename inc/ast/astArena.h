@@ -0,0 +1,52 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator owning every node of an AST. Nodes are never destroyed
+// individually, the whole tree goes away with the arena in one go, which
+// is why only trivially destructible types may live here.
+class ASTArena {
+public:
+    ASTArena() = default;
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+    ASTArena(ASTArena&&) = default;
+    ASTArena& operator=(ASTArena&&) = default;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* copyArray(const T* source, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "Arena arrays are copied bytewise");
+        T* dest = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::uninitialized_copy(source, source + count, dest);
+        return dest;
+    }
+
+    void* allocate(size_t size, size_t align);
+
+    // Takes over the blocks of another arena, so nodes allocated from it
+    // live as long as this one
+    void adopt(ASTArena&& other);
+
+    size_t bytesAllocated() const { return totalBytes; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextBlockSize = 16 * 1024;
+    size_t totalBytes = 0;
+};
+
+#endif // AST_ARENA_H
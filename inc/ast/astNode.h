@@ -1,22 +1,60 @@
 #ifndef ASTNODE_H
 #define ASTNODE_H
 
-#include <vector>
-#include <memory>
+#include <cstdint>
+#include <string>
 #include "lexer.h"
 
-enum class ASTNodeType {
+enum class ASTNodeType : uint8_t {
     VariableDeclaration,
     FunctionDeclaration,
     BinaryExpression,
     Identifier,
     Number,
     Boolean,
+    Module,
     // Add more AST node types as needed
 };
 
+enum class DataType : uint8_t {
+    Unknown,
+    Int,
+    Bool,
+};
+
+// What an identifier resolved to during semantic analysis, a slot among
+// the module's globals or in the frame of the enclosing function
+struct Binding {
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    uint32_t slot = NoSlot;
+    DataType type = DataType::Unknown;
+    bool global = false;
+
+    bool isResolved() const { return slot != NoSlot; }
+};
+
+// Nodes live in an ASTArena (see astArena.h) and are owned by it, links
+// between nodes are plain pointers
 class ASTNode;
-using ASTNodePtr = std::shared_ptr<ASTNode>;
+using ASTNodePtr = ASTNode*;
+
+// Arena-allocated, fixed-size list of child nodes
+class ASTNodeList {
+public:
+    ASTNodeList() = default;
+    ASTNodeList(ASTNode* const* nodes, uint32_t count) : nodes(nodes), count(count) {}
+
+    ASTNode* const* begin() const { return nodes; }
+    ASTNode* const* end() const { return nodes + count; }
+    ASTNode* operator[](size_t i) const { return nodes[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    ASTNode* const* nodes = nullptr;
+    uint32_t count = 0;
+};
 
 class ASTVisitor;
 
@@ -24,58 +62,30 @@ class ASTNode {
 public:
     ASTNode(TokenType tokenType, ASTNodeType nodeType)
         : tokenType(tokenType), nodeType(nodeType) {}
-    virtual ~ASTNode() = default;
 
     TokenType getTokenType() const { return tokenType; }
     ASTNodeType getNodeType() const { return nodeType; }
 
-    void addChild(ASTNodePtr child) { children.push_back(child); }
-    const std::vector<ASTNodePtr>& getChildren() const { return children; }
+    // Type of the value an expression produces, inferred during semantic
+    // analysis
+    DataType getDataType() const { return dataType; }
+    void setDataType(DataType dataType) { this->dataType = dataType; }
 
     virtual void accept(ASTVisitor& visitor) = 0;
 
-    // Function to generate a dot file for the AST
-    virtual std::string toDot() const {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + getTypeName(tokenType) + "\"];\n";
-        for (const auto& child : children) {
-            if (child) { // Check if the child pointer is not null
-                dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(child.get())) + ";\n";
-                dot += child->toDot();
-            }
-        }
-        return dot;
-    }
-
-    // Dummy function for token type name
-    std::string getTypeName(TokenType tokenType) const {
-        switch (tokenType) {
-            case TokenType::Number: return "Number";
-            case TokenType::Identifier: return "Identifier";
-            case TokenType::Equals: return "Equals";
-            case TokenType::OpenParen: return "OpenParen";
-            case TokenType::ClosedParen: return "ClosedParen";
-            case TokenType::OpenBracket: return "OpenBracket";
-            case TokenType::ClosedBracket: return "ClosedBracket";
-            case TokenType::Add: return "Add";
-            case TokenType::Subtract: return "Subtract";
-            case TokenType::Multiply: return "Multiply";
-            case TokenType::Divide: return "Divide";
-            case TokenType::Let: return "Let";
-            case TokenType::Keyword: return "Keyword";
-            case TokenType::BooleanLiteral: return "BooleanLiteral";
-            case TokenType::End: return "End";
-        }
-        return "";
-    }
-
 protected:
+    // Not virtual, nodes are released with their arena and never deleted
+    ~ASTNode() = default;
+
     TokenType tokenType;
     ASTNodeType nodeType;
-    std::vector<ASTNodePtr> children;
+    DataType dataType = DataType::Unknown;
 };
 
 class NumberNode : public ASTNode {
 public:
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::Number; }
+
     NumberNode(int value)
         : ASTNode(TokenType::Number, ASTNodeType::Number), value(value) {}
 
@@ -85,62 +95,56 @@ public:
 
 private:
     int value;
-
-    // Override toDot to include the value
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + std::to_string(value) + "\"];\n";
-        return dot + ASTNode::toDot();
-    }
 };
 
 class IdentifierNode : public ASTNode {
 public:
-    IdentifierNode(const std::string& name)
-        : ASTNode(TokenType::Identifier, ASTNodeType::Identifier), name(name) {}
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::Identifier; }
+
+    IdentifierNode(SymbolId symbol)
+        : ASTNode(TokenType::Identifier, ASTNodeType::Identifier), symbol(symbol) {}
 
-    const std::string& getName() const { return name; }
+    SymbolId getSymbol() const { return symbol; }
+    std::string_view getName() const { return StringInterner::global().lookup(symbol); }
+
+    // Recorded once by semantic analysis, later stages use the slot
+    // instead of looking the name up again
+    void bind(Binding binding) { this->binding = binding; }
+    const Binding& getBinding() const { return binding; }
 
     void accept(ASTVisitor& visitor) override;
 
 private:
-    std::string name;
-
-    // Override toDot to include the name
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + name + "\"];\n";
-        return dot + ASTNode::toDot();
-    }
+    SymbolId symbol;
+    Binding binding;
 };
 
 class BinaryOperatorNode : public ASTNode {
 public:
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::BinaryExpression && node.getTokenType() != TokenType::Equals; }
+
     BinaryOperatorNode(TokenType op, ASTNodePtr left, ASTNodePtr right)
         : ASTNode(op, ASTNodeType::BinaryExpression), left(left), right(right) {}
 
     ASTNodePtr getLeft() const { return left; }
     ASTNodePtr getRight() const { return right; }
 
-    void setResultVar(const std::string& resultVar) { this->resultVar = resultVar; }
-    std::string getResultVar() const { return resultVar; }
+    // Temporary holding the result once IR has been generated
+    void setResultVar(uint32_t resultVar) { this->resultVar = resultVar; }
+    uint32_t getResultVar() const { return resultVar; }
 
     void accept(ASTVisitor& visitor) override;
 
 private:
     ASTNodePtr left;
     ASTNodePtr right;
-    std::string resultVar;
-
-    // Override toDot to include the operator
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + getTypeName(tokenType) + "\"];\n";
-        dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(left.get())) + ";\n";
-        dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(right.get())) + ";\n";
-        return dot + left->toDot() + right->toDot();
-    }
+    uint32_t resultVar = 0;
 };
 
 class EqualsNode : public ASTNode {
 public:
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::BinaryExpression && node.getTokenType() == TokenType::Equals; }
+
     EqualsNode(ASTNodePtr left, ASTNodePtr right)
         : ASTNode(TokenType::Equals, ASTNodeType::BinaryExpression), left(left), right(right) {}
 
@@ -152,18 +156,12 @@ public:
 private:
     ASTNodePtr left;
     ASTNodePtr right;
-
-    // Override toDot to include the operator
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + getTypeName(tokenType) + "\"];\n";
-        dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(left.get())) + ";\n";
-        dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(right.get())) + ";\n";
-        return dot + left->toDot() + right->toDot();
-    }
 };
 
 class LetNode : public ASTNode {
 public:
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::VariableDeclaration; }
+
     LetNode(ASTNodePtr identifier, ASTNodePtr value)
         : ASTNode(TokenType::Let, ASTNodeType::VariableDeclaration), identifier(identifier), value(value) {}
 
@@ -175,48 +173,59 @@ public:
 private:
     ASTNodePtr identifier;
     ASTNodePtr value;
+};
 
-    // Override toDot to include the operator
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + getTypeName(tokenType) + "\"];\n";
-        dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(identifier.get())) + ";\n";
-        dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(value.get())) + ";\n";
-        return dot + identifier->toDot() + value->toDot();
-    }
+// Parses function bodies a lazy parse skipped, see Parser::setLazyBodies
+class BodyParser {
+public:
+    // Tokens between the braces of the body
+    virtual ASTNodeList parseBody(const Token* begin, const Token* end) = 0;
+
+protected:
+    ~BodyParser() = default;
 };
 
 class FunctionNode : public ASTNode {
 public:
-    FunctionNode(const std::string& name, const std::vector<ASTNodePtr>& params, const std::vector<ASTNodePtr>& bodyNodes)
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::FunctionDeclaration; }
+
+    FunctionNode(SymbolId name, ASTNodeList params, ASTNodeList bodyNodes)
         : ASTNode(TokenType::Keyword, ASTNodeType::FunctionDeclaration), name(name), params(params), bodyNodes(bodyNodes) {}
 
-    const std::string& getName() const { return name; }
-    const std::vector<ASTNodePtr>& getParams() const { return params; }
-    const std::vector<ASTNodePtr>& getBodyNodes() const { return bodyNodes; }
+    // Body not parsed yet, only its tokens are known
+    FunctionNode(SymbolId name, ASTNodeList params, BodyParser* bodyParser, const Token* bodyBegin, const Token* bodyEnd)
+        : ASTNode(TokenType::Keyword, ASTNodeType::FunctionDeclaration), name(name), params(params),
+          bodyParser(bodyParser), bodyBegin(bodyBegin), bodyEnd(bodyEnd) {}
 
-    void accept(ASTVisitor& visitor) override;
+    SymbolId getSymbol() const { return name; }
+    std::string_view getName() const { return StringInterner::global().lookup(name); }
+    ASTNodeList getParams() const { return params; }
 
-private:
-    std::string name;
-    std::vector<ASTNodePtr> params;
-    std::vector<ASTNodePtr> bodyNodes;
-
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + name + "\"];\n";
-        for (const auto& param : params) {
-            dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(param.get())) + ";\n";
-            dot += param->toDot();
-        }
-        for (const auto& bodyNode : bodyNodes) {
-            dot += "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " -> node" + std::to_string(reinterpret_cast<std::uintptr_t>(bodyNode.get())) + ";\n";
-            dot += bodyNode->toDot();
+    // Parses a lazy body on first use, which throws on syntax errors
+    ASTNodeList getBodyNodes() {
+        if (bodyParser) {
+            bodyNodes = bodyParser->parseBody(bodyBegin, bodyEnd);
+            bodyParser = nullptr;
         }
-        return dot;
+        return bodyNodes;
     }
+    bool isBodyParsed() const { return bodyParser == nullptr; }
+
+    void accept(ASTVisitor& visitor) override;
+
+private:
+    SymbolId name;
+    ASTNodeList params;
+    ASTNodeList bodyNodes;
+    BodyParser* bodyParser = nullptr;
+    const Token* bodyBegin = nullptr;
+    const Token* bodyEnd = nullptr;
 };
 
 class BooleanLiteralNode : public ASTNode {
 public:
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::Boolean; }
+
     BooleanLiteralNode(bool value)
         : ASTNode(TokenType::BooleanLiteral, ASTNodeType::Boolean), value(value) {}
 
@@ -226,12 +235,28 @@ public:
 
 private:
     bool value;
+};
 
-    // Override toDot to include the value
-    std::string toDot() const override {
-        std::string dot = "node" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + " [label=\"" + (value ? "true" : "false") + "\"];\n";
-        return dot + ASTNode::toDot();
-    }
+// Root of a translation unit, holds every top-level item in source order
+class ModuleNode : public ASTNode {
+public:
+    static bool is(const ASTNode& node) { return node.getNodeType() == ASTNodeType::Module; }
+
+    ModuleNode(ASTNodeList items)
+        : ASTNode(TokenType::End, ASTNodeType::Module), items(items) {}
+
+    ASTNodeList getItems() const { return items; }
+
+    void accept(ASTVisitor& visitor) override;
+
+private:
+    ASTNodeList items;
 };
 
+// Checked downcast on the node type tag, nullptr if node is something else
+template <typename T>
+T* nodeCast(ASTNodePtr node) {
+    return node && T::is(*node) ? static_cast<T*>(node) : nullptr;
+}
+
 #endif // ASTNODE_H
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef AST_PRINTER_H
+#define AST_PRINTER_H
+
+#include <iosfwd>
+#include <vector>
+#include "astNode.h"
+
+enum class ASTDumpFormat {
+    Dot,
+    Json,
+};
+
+// Writes an AST straight to a stream in one traversal, for debugging.
+// Nodes are numbered in the order they are reached, so the same tree
+// always dumps to the same text. Uses an explicit stack, deep operator
+// chains do not grow the C++ stack.
+class ASTPrinter {
+public:
+    explicit ASTPrinter(std::ostream& os) : os(os) {}
+
+    void write(ASTNodePtr root, ASTDumpFormat format);
+    void writeDot(ASTNodePtr root);
+    void writeJson(ASTNodePtr root);
+
+private:
+    std::ostream& os;
+    std::vector<ASTNodePtr> children;
+
+    void collectChildren(ASTNodePtr node);
+    void writeLabel(ASTNodePtr node);
+    void writeJsonFields(ASTNodePtr node, uint32_t id);
+};
+
+#endif // AST_PRINTER_H
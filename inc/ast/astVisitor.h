@@ -12,6 +12,7 @@ public:
     virtual void visit(LetNode& node) = 0;
     virtual void visit(FunctionNode& node) = 0;
     virtual void visit(BooleanLiteralNode& node) = 0;
+    virtual void visit(ModuleNode& node) = 0;
     // Add visit methods for other AST node types...
 };
 
@@ -0,0 +1,75 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <cstdint>
+#include <vector>
+#include "astNode.h"
+
+using FlatNodeId = uint32_t;
+constexpr FlatNodeId NoFlatNode = UINT32_MAX;
+
+// Name and parameter count of a function, kept out of line so every node
+// gets by with a single payload word
+struct FlatFunction {
+    SymbolId name;
+    uint32_t paramCount;
+};
+
+// Structure-of-arrays copy of an AST, bindings and types included. Node i is
+// described by the i-th entry of each array, children are linked through
+// first-child and next-sibling indices. Nodes are numbered in preorder, so
+// iterating the indices in order visits every parent before its children,
+// and the whole tree is plain data that can be written out as is.
+//
+// Children are laid out like the pointer nodes hold them: a module has
+// its items, a function its parameters followed by its body, a let its
+// identifier and value, binary expressions their left and right side.
+class FlatAST {
+public:
+    // Copies a pointer tree, forcing any lazy function bodies
+    static FlatAST build(ASTNodePtr root);
+
+    FlatNodeId root() const { return 0; }
+    size_t size() const { return kinds.size(); }
+
+    ASTNodeType kind(FlatNodeId node) const { return kinds[node]; }
+    TokenType token(FlatNodeId node) const { return static_cast<TokenType>(tokens[node]); }
+    FlatNodeId firstChild(FlatNodeId node) const { return firstChildren[node]; }
+    FlatNodeId nextSibling(FlatNodeId node) const { return nextSiblings[node]; }
+
+    // Number value, boolean as 0 or 1, identifier SymbolId, or the index
+    // of a function in the function table
+    int32_t payload(FlatNodeId node) const { return payloads[node]; }
+    const FlatFunction& function(FlatNodeId node) const { return functions[payloads[node]]; }
+
+    // Resolved binding of an identifier and inferred type of an
+    // expression, filled in by semantic analysis
+    const Binding& binding(FlatNodeId node) const { return bindings[node]; }
+    void bind(FlatNodeId node, Binding binding) { bindings[node] = binding; }
+    DataType type(FlatNodeId node) const { return types[node]; }
+    void setType(FlatNodeId node, DataType type) { types[node] = type; }
+
+    // Binary expressions with an operator, as opposed to assignments
+    bool isArithmetic(FlatNodeId node) const {
+        return kinds[node] == ASTNodeType::BinaryExpression && tokens[node] != TokenType::Equals;
+    }
+
+    // Appends a node as the last child of parent, NoFlatNode for the root.
+    // Nodes must be added in preorder.
+    FlatNodeId addNode(FlatNodeId parent, ASTNodeType kind, TokenType token, int32_t payload);
+    FlatNodeId addFunction(FlatNodeId parent, SymbolId name, uint32_t paramCount);
+
+private:
+    std::vector<ASTNodeType> kinds;
+    std::vector<uint8_t> tokens;
+    std::vector<FlatNodeId> firstChildren;
+    std::vector<FlatNodeId> nextSiblings;
+    std::vector<int32_t> payloads;
+    std::vector<Binding> bindings;
+    std::vector<DataType> types;
+    std::vector<FlatFunction> functions;
+    // Only needed while building, to append children in constant time
+    std::vector<FlatNodeId> lastChildren;
+};
+
+#endif // FLAT_AST_H
@@ -0,0 +1,43 @@
+#ifndef STATIC_VISITOR_H
+#define STATIC_VISITOR_H
+
+#include "astNode.h"
+
+// Compile-time counterpart of ASTVisitor. Derived provides a visit()
+// overload per node type and dispatch() picks one by switching on the
+// node type tag, so there is no virtual accept()/visit() pair per node and
+// the handlers can be inlined. Passes that also implement ASTVisitor should
+// be final, then the calls below bind statically as well.
+template <typename Derived, typename Result = void>
+class StaticASTVisitor {
+public:
+    Result dispatch(ASTNode& node) {
+        Derived& self = static_cast<Derived&>(*this);
+        switch (node.getNodeType()) {
+            case ASTNodeType::Number:
+                return self.visit(static_cast<NumberNode&>(node));
+            case ASTNodeType::Identifier:
+                return self.visit(static_cast<IdentifierNode&>(node));
+            case ASTNodeType::BinaryExpression:
+                // Assignments share the node type, the token tells them apart
+                if (node.getTokenType() == TokenType::Equals) {
+                    return self.visit(static_cast<EqualsNode&>(node));
+                }
+                return self.visit(static_cast<BinaryOperatorNode&>(node));
+            case ASTNodeType::VariableDeclaration:
+                return self.visit(static_cast<LetNode&>(node));
+            case ASTNodeType::FunctionDeclaration:
+                return self.visit(static_cast<FunctionNode&>(node));
+            case ASTNodeType::Boolean:
+                return self.visit(static_cast<BooleanLiteralNode&>(node));
+            case ASTNodeType::Module:
+                return self.visit(static_cast<ModuleNode&>(node));
+        }
+        return Result();
+    }
+
+protected:
+    ~StaticASTVisitor() = default;
+};
+
+#endif // STATIC_VISITOR_H
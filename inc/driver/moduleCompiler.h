@@ -0,0 +1,72 @@
+#ifndef MODULE_COMPILER_H
+#define MODULE_COMPILER_H
+
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+#include "astNode.h"
+#include "semanticAnalyzer.h"
+#include "irGenerator.h"
+#include "codeGenerator.h"
+#include "threadPool.h"
+#include "passManager.h"
+
+// Runs semantic analysis, IR generation, the optimization passes and code
+// generation over a parsed module, one function at a time on the thread
+// pool.
+//
+// The top-level statements are analyzed first, in order, which builds the
+// global scope. After that every function gets its own analyzer, IR
+// generator and code generator, reading the globals declared before it
+// but never changing them, so functions can be compiled in any order on
+// any thread. Runs of top-level statements between functions are compiled
+// the same way. Globals are numbered by their slot and kept in memory in
+// every unit, so a global is in the same place for the unit that writes it
+// and the units that read it. The results are kept per unit in source
+// order, so the IR, the diagnostics and the machine code come out the same
+// for every pool size.
+class ModuleCompiler {
+public:
+    explicit ModuleCompiler(ThreadPool& pool, PassManager passes = PassManager::forLevel(PassManager::DefaultLevel))
+        : pool(pool), passes(std::move(passes)) {}
+
+    // Diagnostics are written to errors in source order. Throws the first
+    // error in source order, after the diagnostics leading up to it.
+    void compile(ModuleNode& module, std::ostream& errors = std::cerr);
+
+    // IR of every unit, in source order
+    void printIR() const;
+
+    // Machine code of the whole module
+    const CodeGenerator& getCode() const { return code; }
+
+    // What the passes did, summed over all functions
+    const PassStatistics& getStats() const { return stats; }
+
+    size_t getUnitCount() const { return units.size(); }
+    // IR of a unit after the passes
+    const IRGenerator& getIR(size_t unit) const { return units[unit].ir; }
+
+private:
+    // A function, or a run of top-level statements between two functions
+    struct Unit {
+        size_t begin;
+        size_t end;
+        FunctionNode* function = nullptr;
+        uint32_t visibleGlobals = 0;
+        IRGenerator ir;
+        CodeGenerator code;
+        PassStatistics stats;
+        std::string diagnostics;
+        std::exception_ptr error;
+    };
+
+    ThreadPool& pool;
+    PassManager passes;
+    std::vector<Unit> units;
+    CodeGenerator code;
+    PassStatistics stats;
+};
+
+#endif // MODULE_COMPILER_H
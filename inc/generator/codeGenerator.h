@@ -8,12 +8,25 @@
 class CodeGenerator {
 public:
     CodeGenerator() = default;
+    // Variables below globalCount are globals numbered by slot, see
+    // IRGenerator. They live in memory rather than in registers, so code
+    // generated for different functions agrees on where they are.
+    explicit CodeGenerator(uint32_t globalCount) : globalCount(globalCount) {}
     ~CodeGenerator() = default;
 
-    void generateCode(const std::vector<IRInstruction>& instructions);
+    void generateCode(const IRInstruction* instructions, size_t count);
+    void generateCode(const std::vector<IRInstruction>& instructions) { generateCode(instructions.data(), instructions.size()); }
+    void generateCode(const IRFunction& function) { generateCode(function.getInstructions()); }
 
     void disassembleCode() const;
 
+    const std::vector<uint8_t>& getCode() const { return generatedCode; }
+
+    // Appends code generated separately, e.g. for another function
+    void append(const CodeGenerator& other) {
+        generatedCode.insert(generatedCode.end(), other.generatedCode.begin(), other.generatedCode.end());
+    }
+
     void printCode() const {
         for (uint8_t byte : generatedCode) {
             std::cout << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte) << ' ';
@@ -30,24 +43,46 @@ private:
     void handleStore(const IRInstruction& instruction);
     void handleAlloc(const IRInstruction& instruction);
     void handleRet(const IRInstruction& instruction);
+    void handleZext(const IRInstruction& instruction);
 
     std::vector<uint8_t> generatedCode;
 
-    std::unordered_map<std::string, uint8_t> registerMap;
+    // Global slot s is the 4-byte cell at offset 4 * s of the data area,
+    // addressed absolutely for the loader to relocate. Bytes are widened
+    // before any arithmetic, so globals are always moved as 32 bits.
+    uint32_t globalCount = 0;
+    bool isGlobal(const IROperand& var) const { return var.kind == IROperandKind::Variable && var.value < globalCount; }
+    static uint32_t globalAddress(const IROperand& var) { return var.value * 4; }
+
+    static constexpr uint8_t NoRegister = 0xFF;
+
+    // Register currently holding each temporary and variable, indexed by
+    // temporary and variable number respectively
+    std::vector<uint8_t> tempRegisters;
+    std::vector<uint8_t> variableRegisters;
+    IROperand registerOwner[8];
     uint8_t nextRegister = 0;
+    uint8_t nextSpill = 0;
 
     void encodeInstruction(uint8_t opcode);
     void encodeInstruction(uint8_t opcode, uint8_t reg, uint8_t rm);
     void encodeInstruction(uint8_t opcode, uint8_t opcode2, uint8_t reg, uint8_t rm);
 
     void encodeImmediate(uint8_t opcode, uint8_t reg, int32_t imm);
+    void encodeAbsolute(uint8_t opcode, uint8_t reg, uint32_t address);
+    void encodeArithmeticImmediate(uint8_t extension, uint8_t dest, uint8_t reg, int32_t imm);
 
-    uint8_t getRegisterCode(const std::string& reg);
-    uint8_t allocateRegister(const std::string& var);
-    void spillRegister();
-    void reloadRegister(const std::string& var);
+    static bool fitsInByte(int32_t imm) { return imm >= -128 && imm <= 127; }
 
-    bool isInteger(const std::string& s);
+    // In 32-bit mode only EAX..EBX have a low byte register, codes 4-7
+    // name AH..BH in byte instructions
+    static bool hasByteRegister(uint8_t reg) { return reg < 4; }
+
+    uint8_t getRegisterCode(const std::string& reg);
+    uint8_t& registerSlot(const IROperand& var);
+    uint8_t allocateRegister(const IROperand& var);
+    uint8_t spillRegister();
+    void reloadRegister(const IROperand& var);
 };
 
 #endif // CODE_GENERATOR_H
\ No newline at end of file
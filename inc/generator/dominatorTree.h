@@ -0,0 +1,41 @@
+#ifndef DOMINATOR_TREE_H
+#define DOMINATOR_TREE_H
+
+#include <vector>
+#include "irFunction.h"
+
+// Immediate dominators of the blocks of a function, computed with the
+// iterative algorithm of Cooper, Harvey and Kennedy over reverse
+// postorder. The tree is then numbered in preorder so dominance queries
+// are two comparisons. Blocks unreachable from the entry have no
+// dominator and dominate nothing.
+class DominatorTree {
+public:
+    explicit DominatorTree(const IRFunction& function);
+
+    // NoBlock for the entry and unreachable blocks
+    BlockId getIdom(BlockId block) const { return idoms[block]; }
+    const std::vector<BlockId>& getChildren(BlockId block) const { return children[block]; }
+    bool isReachable(BlockId block) const { return rpoIndex[block] != NoIndex; }
+
+    // Whether every path from the entry to b goes through a, a block
+    // dominates itself
+    bool dominates(BlockId a, BlockId b) const;
+
+    // Reachable blocks, each after all of its dominators
+    const std::vector<BlockId>& getReversePostorder() const { return reversePostorder; }
+
+private:
+    static constexpr uint32_t NoIndex = UINT32_MAX;
+
+    std::vector<BlockId> idoms;
+    std::vector<std::vector<BlockId>> children;
+    std::vector<BlockId> reversePostorder;
+    std::vector<uint32_t> rpoIndex;
+    // Preorder number of each block in the tree and one past its last
+    // descendant's
+    std::vector<uint32_t> treeBegin;
+    std::vector<uint32_t> treeEnd;
+};
+
+#endif // DOMINATOR_TREE_H
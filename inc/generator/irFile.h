@@ -0,0 +1,166 @@
+#ifndef IR_FILE_H
+#define IR_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "irFunction.h"
+#include "irGenerator.h"
+#include "sourceBuffer.h"
+
+// Binary IR container. Every section is an array of fixed-size records at
+// an 8-byte aligned offset given in the header, so a mapped file is used
+// in place: the instruction records are IRInstruction as is and go
+// straight to the code generator. All values are in the byte order of the
+// machine that wrote the file, which byteOrder records, and all indices
+// are relative to the enclosing unit or function.
+//
+//   IRFileHeader
+//   IRFileUnit[unitCount]          functions numbering variables together
+//   IRFileFunction[functionCount]
+//   IRFileBlock[blockCount]
+//   uint32_t[edgeCount]            successors, then predecessors of a block
+//   IRInstruction[instructionCount]
+//   IRFileOperand[phiOperandCount]
+//   uint32_t[localCount]           local variables of each function
+//   uint32_t[variableCount]        string of each variable's name
+//   IRFileString[stringCount]
+//   char[stringBytes]
+//
+// Readers reject files whose version or byte order differs from theirs.
+constexpr uint32_t IRFileVersion = 1;
+constexpr uint32_t NoString = UINT32_MAX;
+
+struct IRFileHeader {
+    char magic[4];              // "BMIR"
+    uint32_t version;
+    uint32_t byteOrder;         // 0x01020304 as written
+    uint32_t instructionSize;
+    uint32_t fileSize;
+    uint32_t unitCount, unitOffset;
+    uint32_t functionCount, functionOffset;
+    uint32_t blockCount, blockOffset;
+    uint32_t edgeCount, edgeOffset;
+    uint32_t instructionCount, instructionOffset;
+    uint32_t phiOperandCount, phiOperandOffset;
+    uint32_t localCount, localOffset;
+    uint32_t variableCount, variableOffset;
+    uint32_t stringCount, stringOffset;
+    uint32_t stringBytes, stringDataOffset;
+};
+
+// Output of one IRGenerator, the code generator starts over for each.
+// The first globalCount variables are globals numbered by slot, temporaries
+// are numbered below tempCount.
+struct IRFileUnit {
+    uint32_t firstFunction, functionCount;
+    uint32_t firstVariable, variableCount;
+    uint32_t globalCount;
+    uint32_t tempCount;
+};
+
+struct IRFileFunction {
+    uint32_t name;              // NoString for initializers
+    uint32_t firstBlock, blockCount;
+    uint32_t firstInstruction, instructionCount;
+    uint32_t firstPhiOperand, phiOperandCount;
+    uint32_t firstLocal, localCount;
+};
+
+struct IRFileBlock {
+    uint32_t begin, end;
+    uint32_t firstEdge, successorCount, predecessorCount;
+};
+
+struct IRFileOperand {
+    uint32_t kind;
+    uint32_t value;
+};
+
+struct IRFileString {
+    uint32_t offset, length;
+};
+
+// Collects the IR of one or more generators and writes it out
+class IRFileWriter {
+public:
+    // Functions and variable names of a generator, as they are now
+    void addUnit(const IRGenerator& generator);
+
+    // Throws if the file cannot be written
+    void write(const std::string& filename) const;
+
+private:
+    std::vector<IRFileUnit> units;
+    std::vector<IRFileFunction> functions;
+    std::vector<IRFileBlock> blocks;
+    std::vector<uint32_t> edges;
+    std::vector<IRInstruction> instructions;
+    std::vector<IRFileOperand> phiOperands;
+    std::vector<uint32_t> locals;
+    std::vector<uint32_t> variables;
+    std::vector<IRFileString> strings;
+    std::string stringData;
+    // String of every symbol written so far
+    std::vector<uint32_t> symbolStrings;
+
+    uint32_t string(SymbolId symbol);
+};
+
+// Maps an IR file and checks every record before handing any of it out:
+// sections and ranges lie within the file, instructions have a known
+// opcode and value type and operands of the right kind for it, temporaries
+// and variables are numbered below their unit's counts and branch targets
+// are blocks of their function. The accessors point into the mapping.
+class IRFile {
+public:
+    // Throws if the file is not well-formed IR of this version
+    explicit IRFile(const std::string& filename);
+
+    const IRFileHeader& getHeader() const { return *header; }
+
+    size_t getUnitCount() const { return header->unitCount; }
+    const IRFileUnit& getUnit(size_t unit) const { return section<IRFileUnit>(header->unitOffset)[unit]; }
+    const IRFileFunction& getFunction(const IRFileUnit& unit, size_t function) const {
+        return section<IRFileFunction>(header->functionOffset)[unit.firstFunction + function];
+    }
+
+    const IRFileBlock* getBlocks(const IRFileFunction& function) const {
+        return section<IRFileBlock>(header->blockOffset) + function.firstBlock;
+    }
+    const uint32_t* getEdges(const IRFileBlock& block) const { return section<uint32_t>(header->edgeOffset) + block.firstEdge; }
+    const IRInstruction* getInstructions(const IRFileFunction& function) const {
+        return section<IRInstruction>(header->instructionOffset) + function.firstInstruction;
+    }
+    const IRFileOperand* getPhiOperands(const IRFileFunction& function) const {
+        return section<IRFileOperand>(header->phiOperandOffset) + function.firstPhiOperand;
+    }
+    const uint32_t* getLocalVariables(const IRFileFunction& function) const {
+        return section<uint32_t>(header->localOffset) + function.firstLocal;
+    }
+
+    // Name of a variable of the unit
+    std::string_view getVariableName(const IRFileUnit& unit, uint32_t variable) const {
+        return getString(section<uint32_t>(header->variableOffset)[unit.firstVariable + variable]);
+    }
+    std::string_view getString(uint32_t string) const;
+
+    // Copy of a function that passes can change, names are interned into
+    // the global pool
+    IRFunction loadFunction(const IRFileUnit& unit, size_t function) const;
+
+private:
+    std::unique_ptr<SourceBuffer> buffer;
+    const char* base;
+    const IRFileHeader* header;
+
+    template <typename Record>
+    const Record* section(uint32_t offset) const { return reinterpret_cast<const Record*>(base + offset); }
+
+    bool isValid(const IRFileUnit& unit, const IRFileFunction& function, const IRInstruction& instruction) const;
+};
+
+#endif // IR_FILE_H
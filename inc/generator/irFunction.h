@@ -0,0 +1,186 @@
+#ifndef IR_FUNCTION_H
+#define IR_FUNCTION_H
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "astNode.h"
+
+// Enum for different types of IR instructions
+enum class IRInstructionType : uint8_t {
+    ADD,        // the arithmetic ops take their first operand in a temporary,
+    SUB,        // ADD, SUB and MUL their second one may be an immediate
+    MUL,
+    DIV,
+    LOAD,
+    STORE,
+    ALLOC,
+    RET,
+    ZEXT,       // widens a byte value to 32 bits
+    JMP,        // src1 holds the target block
+    BR,         // src1 is the condition, dest and src2 the blocks taken if it is nonzero and zero
+    PHI,        // src1 and src2 locate the incoming values in the function's phi operands
+    // Add more as needed
+};
+
+// Width of the value an instruction produces or stores
+enum class IRType : uint8_t {
+    Void,
+    I8,         // bools
+    I32,        // ints
+};
+
+// IR type of a source level type, unknown values are treated as ints
+inline IRType irType(DataType type) {
+    return type == DataType::Bool ? IRType::I8 : IRType::I32;
+}
+
+enum class IROperandKind : uint8_t {
+    None,
+    Temp,       // compiler temporary, value is its number
+    Variable,   // named variable, value is its number within the IR
+    Immediate,  // constant, value holds the 32-bit pattern
+};
+
+// Instruction operand, temporaries and variables are referred to by number
+// so later stages can use them as array indices
+struct IROperand {
+    IROperandKind kind = IROperandKind::None;
+    uint32_t value = 0;
+
+    static IROperand temp(uint32_t index) { return IROperand{IROperandKind::Temp, index}; }
+    static IROperand variable(uint32_t index) { return IROperand{IROperandKind::Variable, index}; }
+    static IROperand immediate(int32_t imm) { return IROperand{IROperandKind::Immediate, static_cast<uint32_t>(imm)}; }
+
+    bool isNone() const { return kind == IROperandKind::None; }
+    bool isImmediate() const { return kind == IROperandKind::Immediate; }
+    int32_t getImmediate() const { return static_cast<int32_t>(value); }
+
+    bool operator==(const IROperand& other) const { return kind == other.kind && value == other.value; }
+};
+
+std::ostream& operator<<(std::ostream& os, const IROperand& operand);
+
+// IR instruction, packed into 16 bytes so a function's IR is one flat
+// array: opcode, value type, the kinds of the three operands at two bits
+// each, a zero byte, then the operand values. Operands are unpacked on
+// access.
+struct IRInstruction {
+    IRInstructionType type;
+    IRType valueType;
+    uint8_t operandKinds;
+    uint8_t reserved;           // zero, so instructions can be compared and saved bytewise
+    uint32_t operands[3];
+
+    IRInstruction(IRInstructionType t, IROperand d, IROperand s1, IROperand s2 = IROperand(), IRType vt = IRType::I32)
+        : type(t), valueType(vt), operandKinds(0), reserved(0), operands{} {
+        setOperand(0, d);
+        setOperand(1, s1);
+        setOperand(2, s2);
+    }
+
+    IROperand operand(unsigned index) const {
+        return IROperand{static_cast<IROperandKind>(operandKinds >> (2 * index) & 3), operands[index]};
+    }
+    void setOperand(unsigned index, IROperand operand) {
+        operandKinds = static_cast<uint8_t>((operandKinds & ~(3 << (2 * index))) | static_cast<uint8_t>(operand.kind) << (2 * index));
+        operands[index] = operand.value;
+    }
+
+    IROperand dest() const { return operand(0); }
+    IROperand src1() const { return operand(1); }
+    IROperand src2() const { return operand(2); }
+};
+
+static_assert(sizeof(IRInstruction) == 16, "IR instructions should stay packed");
+
+// Arithmetic with an immediate form for its second operand
+inline bool hasImmediateForm(IRInstructionType type) {
+    return type == IRInstructionType::ADD || type == IRInstructionType::SUB || type == IRInstructionType::MUL;
+}
+
+// Instructions that end a basic block
+inline bool isTerminator(IRInstructionType type) {
+    return type == IRInstructionType::RET || type == IRInstructionType::JMP || type == IRInstructionType::BR;
+}
+
+using BlockId = uint32_t;
+constexpr BlockId NoBlock = UINT32_MAX;
+
+// Straight-line run of instructions, [begin, end) of its function
+struct BasicBlock {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    std::vector<BlockId> predecessors;
+    std::vector<BlockId> successors;
+};
+
+// IR of one function as basic blocks. The instructions of all blocks are
+// kept in one array in layout order, each block is a range of it, and the
+// first block is the entry. Every block ends in a terminator except that
+// the last one may run off the end, which leaves the function; module
+// initializers end that way since control continues into whatever code
+// follows them.
+class IRFunction {
+public:
+    // InvalidSymbol for the code of top-level statements
+    explicit IRFunction(SymbolId name = InvalidSymbol) : name(name) {}
+
+    SymbolId getName() const { return name; }
+    bool isInitializer() const { return name == InvalidSymbol; }
+
+    const std::vector<IRInstruction>& getInstructions() const { return instructions; }
+    // For rewriting instructions in place, blocks have to keep their sizes
+    std::vector<IRInstruction>& getInstructions() { return instructions; }
+    const std::vector<BasicBlock>& getBlocks() const { return blocks; }
+    const BasicBlock& getBlock(BlockId block) const { return blocks[block]; }
+    size_t getBlockCount() const { return blocks.size(); }
+    BlockId entry() const { return 0; }
+
+    // Starts a new block, later instructions are appended to it
+    BlockId addBlock();
+    void append(const IRInstruction& instruction);
+    void jump(BlockId target);
+    void branch(IROperand condition, BlockId ifTrue, BlockId ifFalse);
+
+    // Replaces the instructions of all blocks at once, blockEnds[b] is
+    // where block b now ends. The edges are kept, so terminators have to
+    // stay as they are.
+    void replaceInstructions(std::vector<IRInstruction> rewritten, const std::vector<uint32_t>& blockEnds);
+
+    // Phi nodes keep one incoming value per predecessor of their block, in
+    // the order of its predecessor list, out of line
+    IRInstruction makePhi(IROperand dest, IRType valueType, uint32_t incomingCount);
+    IROperand* phiIncoming(const IRInstruction& phi) { return phiOperands.data() + phi.src1().value; }
+    const IROperand* phiIncoming(const IRInstruction& phi) const { return phiOperands.data() + phi.src1().value; }
+    void clearPhiOperands() { phiOperands.clear(); }
+    // All of them at once, for saving and loading functions
+    const std::vector<IROperand>& getPhiOperands() const { return phiOperands; }
+    void setPhiOperands(std::vector<IROperand> operands) { phiOperands = std::move(operands); }
+
+    // Variables only this function uses, which may live in registers
+    // rather than memory
+    const std::vector<uint32_t>& getLocalVariables() const { return localVariables; }
+    void setLocalVariables(std::vector<uint32_t> variables) { localVariables = std::move(variables); }
+
+    // Drops the blocks marked in removed, which must not include the entry
+    // and must not be reached from the blocks that stay. The rest keep
+    // their order and are renumbered, branches and phis follow them.
+    void removeBlocks(const std::vector<bool>& removed);
+
+    // Fills in the edges from the terminators, once the blocks are built or
+    // after a pass changed a terminator. Phi operands follow their edges.
+    // Throws if a block other than the last falls through or a branch
+    // targets a block that does not exist.
+    void buildCFG();
+
+private:
+    SymbolId name;
+    std::vector<IRInstruction> instructions;
+    std::vector<BasicBlock> blocks;
+    std::vector<IROperand> phiOperands;
+    std::vector<uint32_t> localVariables;
+};
+
+#endif // IR_FUNCTION_H
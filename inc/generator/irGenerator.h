@@ -3,53 +3,53 @@
 
 #include "astNode.h"
 #include "astVisitor.h"
+#include "staticVisitor.h"
+#include "flatAst.h"
+#include "irFunction.h"
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <iostream>
 
-// Enum for different types of IR instructions
-enum class IRInstructionType {
-    ADD,
-    SUB,
-    MUL,
-    DIV,
-    LOAD,
-    STORE,
-    ALLOC,
-    RET,
-    // Add more as needed
-};
-
-// Structure to represent an IR instruction
-struct IRInstruction {
-    IRInstructionType type;
-    std::string dest;
-    std::string src1;
-    std::string src2;
-
-    IRInstruction(IRInstructionType t, const std::string& d, const std::string& s1, const std::string& s2 = "")
-        : type(t), dest(d), src1(s1), src2(s2) {}
-};
-
-class IRGenerator : public ASTVisitor {
+class IRGenerator final : public ASTVisitor, public StaticASTVisitor<IRGenerator> {
 public:
     IRGenerator() : tempVarCounter(0) {}
+    // Numbers the first globalCount globals of the module by their slot, so
+    // IR variable s is global slot s in every generator of the module and
+    // code for separately generated functions agrees on where a global is.
+    // Globals past the count are numbered on first use like locals.
+    explicit IRGenerator(uint32_t globalCount);
     ~IRGenerator() = default;
 
     void generateIR(ASTNodePtr root);
+    // Same instructions, generated from the flat representation
+    void generateIR(const FlatAST& ast);
+
+    // One IRFunction per function, nested ones included, and one for each
+    // run of top-level statements, in the order they start in the source
+    const std::vector<IRFunction>& getFunctions() const { return functions; }
+    std::vector<IRFunction>& getFunctions() { return functions; }
+    // Hands the functions over, leaving the generator empty
+    std::vector<IRFunction> takeFunctions() { return std::move(functions); }
 
-    std::vector<IRInstruction> getIRInstructions() const { return irInstructions; }
+    void printIR() const;
 
-    void printIR() {
-        for (const auto& instr : irInstructions) {
-            std::cout << "Instruction: " << static_cast<int>(instr.type) << " " << instr.dest << " " << instr.src1 << " " << instr.src2 << std::endl;
-        }
-    }
+    // Next unused temporary, passes that create temporaries take it from here
+    uint32_t& getTempCounter() { return tempVarCounter; }
+    uint32_t getTempCount() const { return tempVarCounter; }
+
+    // Source name of an IR variable
+    SymbolId getVariableName(uint32_t variable) const { return variableNames[variable]; }
+    uint32_t getVariableCount() const { return static_cast<uint32_t>(variableNames.size()); }
+    // Variables numbered by global slot, [0, getGlobalCount())
+    uint32_t getGlobalCount() const { return globalCount; }
 
     // Visitor methods
     void visit(BinaryOperatorNode& node) override;
     void visit(LetNode& node) override;
     void visit(FunctionNode& node) override;
+    void visit(ModuleNode& node) override;
 
     void visit(NumberNode& node) override;
     void visit(IdentifierNode& node) override;
@@ -57,14 +57,52 @@ public:
     void visit(EqualsNode& node) override {}
 
 private:
-    std::vector<IRInstruction> irInstructions;
-    int tempVarCounter;
+    static constexpr uint32_t NoVariable = UINT32_MAX;
+    static constexpr uint32_t NoFunction = UINT32_MAX;
+    static constexpr uint32_t SharedVariable = UINT32_MAX - 1;
+
+    std::vector<IRFunction> functions;
+    // Functions being generated, innermost last, and the initializer
+    // top-level statements currently go to
+    std::vector<uint32_t> openFunctions;
+    uint32_t initializer = NoFunction;
+    uint32_t tempVarCounter;
+    uint32_t globalCount = 0;
+
+    // IR variable of every global and of every slot in the frame of the
+    // function being generated, assigned on first use
+    std::vector<uint32_t> globalVariables;
+    std::vector<uint32_t> frameVariables;
+    std::vector<SymbolId> variableNames;
+    // Function using each variable, SharedVariable for globals and for
+    // frame variables nested functions use as well
+    std::vector<uint32_t> variableFunctions;
+    // First function and first variable of the top-level function being
+    // generated
+    uint32_t groupBegin = 0;
+    uint32_t groupVariables = 0;
+    // Identifiers semantic analysis could not resolve, by name
+    std::unordered_map<SymbolId, uint32_t> unresolvedVariables;
+
+    IROperand newTempVar() { return IROperand::temp(tempVarCounter++); }
+    IROperand variable(SymbolId name, const Binding& binding);
+
+    void beginFunction(SymbolId name);
+    void endFunction();
 
-    std::string newTempVar() { return "t" + std::to_string(tempVarCounter++); }
+    void generateInstruction(IRInstructionType type, IROperand dest, IROperand src1, IROperand src2 = IROperand(),
+                             IRType valueType = IRType::I32);
 
-    void generateInstruction(IRInstructionType type, const std::string& dest, const std::string& src1, const std::string& src2 = "");
+    IROperand handleLiteral(ASTNodePtr node);
+    IROperand arithmeticOperand(ASTNodePtr node);
+    IROperand rightOperand(ASTNodePtr node, IRInstructionType type);
+    IROperand widen(IROperand value, DataType type);
 
-    std::string handleLiteral(ASTNodePtr node);
+    void generateFlat(const FlatAST& ast, FlatNodeId node);
+    IROperand flatLiteral(const FlatAST& ast, FlatNodeId node);
+    IROperand flatOperand(const FlatAST& ast, FlatNodeId node);
+    IROperand flatRightOperand(const FlatAST& ast, FlatNodeId node, IRInstructionType type);
+    IROperand flatBinary(const FlatAST& ast, FlatNodeId node);
 };
 
 #endif // IR_GENERATOR_H
\ No newline at end of file
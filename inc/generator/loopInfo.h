@@ -0,0 +1,43 @@
+#ifndef LOOP_INFO_H
+#define LOOP_INFO_H
+
+#include <vector>
+#include "irFunction.h"
+#include "dominatorTree.h"
+
+using LoopId = uint32_t;
+constexpr LoopId NoLoop = UINT32_MAX;
+
+// Natural loop: a header and every block that reaches one of the back
+// edges into it without passing through the header
+struct Loop {
+    BlockId header;
+    LoopId parent = NoLoop;
+    uint32_t depth = 1;
+    std::vector<BlockId> blocks;  // header first, nested loops' blocks included
+};
+
+// Loop nesting forest of a function. An edge is a back edge when its
+// target dominates its source, back edges into the same header make up
+// one loop.
+class LoopInfo {
+public:
+    LoopInfo(const IRFunction& function, const DominatorTree& dominators);
+
+    // Outer loops come before the loops nested in them
+    const std::vector<Loop>& getLoops() const { return loops; }
+    const Loop& getLoop(LoopId loop) const { return loops[loop]; }
+
+    // Innermost loop containing the block
+    LoopId getLoopFor(BlockId block) const { return innermost[block]; }
+    // Number of loops containing the block, 0 outside of loops
+    uint32_t getLoopDepth(BlockId block) const {
+        return innermost[block] == NoLoop ? 0 : loops[innermost[block]].depth;
+    }
+
+private:
+    std::vector<Loop> loops;
+    std::vector<LoopId> innermost;
+};
+
+#endif // LOOP_INFO_H
@@ -0,0 +1,42 @@
+#ifndef CHAR_SCAN_H
+#define CHAR_SCAN_H
+
+#include <array>
+#include <cstdint>
+
+// Character classes used by the lexer. These are fixed ASCII tables rather
+// than <cctype>, so classification does not depend on the current locale.
+enum CharClass : uint8_t {
+    CharSpace = 1 << 0,
+    CharAlpha = 1 << 1,
+    CharDigit = 1 << 2,
+    CharPunct = 1 << 3,
+};
+
+extern const std::array<uint8_t, 256> charClassTable;
+
+inline uint8_t charClass(char c) { return charClassTable[static_cast<unsigned char>(c)]; }
+inline bool isDelimiter(char c) { return charClass(c) & (CharSpace | CharPunct); }
+
+// Scanning kernel implementations. Auto picks AVX2 when the CPU supports
+// it, SSE2 otherwise. All of them give identical results.
+enum class ScanMode {
+    Auto,
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+// Returns false if the requested mode is not available on this machine
+bool setScanMode(ScanMode mode);
+ScanMode getScanMode();
+
+// Each kernel returns the first position in [p, end) that ends the run,
+// or end if the run reaches the end of the buffer.
+const char* skipWhitespace(const char* p, const char* end);
+const char* scanAlpha(const char* p, const char* end);
+const char* scanDigits(const char* p, const char* end);
+const char* scanToDelimiter(const char* p, const char* end);
+const char* findNewline(const char* p, const char* end);
+
+#endif // CHAR_SCAN_H
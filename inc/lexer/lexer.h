@@ -1,8 +1,11 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <iosfwd>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "stringInterner.h"
 
 enum TokenType {
     Number,
@@ -22,11 +25,50 @@ enum TokenType {
     End
 };
 
+// Tokens do not own their text, value views into the source buffer they
+// were lexed from, so that buffer has to outlive the tokens. Identifiers
+// are interned while lexing and carry their SymbolId.
 struct Token {
-    std::string value;
+    std::string_view value;
     TokenType type;
+    SymbolId symbol = InvalidSymbol;
 };
 
-std::vector<Token> tokenize(std::string &sourceCode);
+// Single forward pass over a source buffer, producing one token at a time
+class Lexer {
+public:
+    Lexer(std::string_view source, StringInterner& interner = StringInterner::global());
 
-#endif // LEXER_H
\ No newline at end of file
+    // Lex one chunk of a larger input. A token that may continue past the
+    // end of the chunk is left unread and a comment running off the end is
+    // remembered, so the caller can carry both into the next chunk.
+    Lexer(std::string_view chunk, StringInterner& interner, bool partial, bool insideComment);
+
+    // Returns false once the end of the input is reached
+    bool next(Token& token);
+
+    size_t consumed() const { return cursor - begin; }
+    bool isInsideComment() const { return insideComment; }
+
+    // Where unrecognized words are reported, std::cout by default
+    void setDiagnostics(std::ostream& os) { diagnostics = &os; }
+
+private:
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    StringInterner& interner;
+    bool partial = false;
+    bool insideComment = false;
+    std::ostream* diagnostics;
+};
+
+class ThreadPool;
+
+std::vector<Token> tokenize(std::string_view sourceCode);
+
+// Splits the source at line boundaries and lexes the pieces on the pool.
+// Tokens, symbol ids and diagnostics are exactly those of tokenize().
+std::vector<Token> tokenize(std::string_view sourceCode, ThreadPool& pool);
+
+#endif // LEXER_H
@@ -0,0 +1,28 @@
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <string>
+#include <string_view>
+
+// Read-only view of a source file. Regular files are memory-mapped so the
+// lexer can scan them in place; anything that cannot be mapped (pipes,
+// character devices) is read into an owned buffer instead.
+class SourceBuffer {
+public:
+    explicit SourceBuffer(const std::string& filename);
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    std::string_view view() const { return std::string_view(data, size); }
+    bool isMapped() const { return mapped; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string fallback;
+};
+
+#endif // SOURCE_BUFFER_H
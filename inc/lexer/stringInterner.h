@@ -0,0 +1,48 @@
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Dense id given to every distinct identifier, ids start at 0 so later
+// stages can index side tables with them directly
+using SymbolId = uint32_t;
+constexpr SymbolId InvalidSymbol = UINT32_MAX;
+
+// Maps each distinct string to a SymbolId. Interned text is stored in
+// blocks that never move, so views returned by lookup() stay valid for the
+// lifetime of the interner. Not safe for concurrent interning.
+class StringInterner {
+public:
+    StringInterner();
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    SymbolId intern(std::string_view text);
+    std::string_view lookup(SymbolId id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+
+    // Pool shared by every stage of the compiler
+    static StringInterner& global();
+
+private:
+    struct Slot {
+        uint32_t hash;
+        SymbolId id;
+    };
+
+    std::vector<Slot> table;
+    std::vector<std::string_view> strings;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockRemaining = 0;
+    char* blockCursor = nullptr;
+
+    const char* store(std::string_view text);
+    void grow();
+};
+
+#endif // STRING_INTERNER_H
@@ -0,0 +1,56 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <string>
+#include <vector>
+#include "lexer.h"
+
+// Pull-based source of tokens. Tokens are handed out a window at a time,
+// a window stays valid until the next call to nextWindow().
+class TokenStream {
+public:
+    virtual ~TokenStream() = default;
+
+    // Returns false once the input is exhausted
+    virtual bool nextWindow(const Token*& begin, const Token*& end) = 0;
+};
+
+// Reads a file (or stdin for "-") in fixed-size chunks and lexes each
+// chunk as it arrives, so memory use is bounded by the chunk size rather
+// than the input size. Identifier text is re-pointed at the interner and
+// keywords and punctuators at static storage, so those stay valid after
+// their chunk is reused. Number literals are copied into a buffer owned
+// by the window, which is kept until the window after the next one so a
+// copy of the last token of a window still reads its text after a refill.
+class ChunkedLexer : public TokenStream {
+public:
+    static constexpr size_t defaultChunkSize = 64 * 1024;
+
+    explicit ChunkedLexer(const std::string& filename, size_t chunkSize = defaultChunkSize,
+                          StringInterner& interner = StringInterner::global());
+    ~ChunkedLexer();
+
+    ChunkedLexer(const ChunkedLexer&) = delete;
+    ChunkedLexer& operator=(const ChunkedLexer&) = delete;
+
+    bool nextWindow(const Token*& begin, const Token*& end) override;
+
+private:
+    int fd;
+    size_t chunkSize;
+    StringInterner& interner;
+
+    std::vector<char> buffer;
+    size_t carryBegin = 0;
+    size_t carrySize = 0;
+    bool insideComment = false;
+    bool finished = false;
+
+    std::vector<Token> window;
+    std::string numbers;
+    std::string previousNumbers;
+
+    void stabilize(Token& token);
+};
+
+#endif // TOKEN_STREAM_H
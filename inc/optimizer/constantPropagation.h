@@ -0,0 +1,26 @@
+#ifndef CONSTANT_PROPAGATION_H
+#define CONSTANT_PROPAGATION_H
+
+#include <cstddef>
+#include "irFunction.h"
+
+// Sparse conditional constant propagation (Wegman and Zadeck) over a
+// function in SSA form. Every temporary starts out unknown and only moves
+// down to a constant and then to overdefined, instructions are revisited
+// when an operand changes and only blocks reachable under the constants
+// found so far count.
+//
+// Afterwards instructions with a constant result become loads of that
+// constant, copies, stores and phis read immediates instead of constant
+// temporaries, so does the second operand of ADD, SUB and MUL, and
+// branches on constants become jumps. Arithmetic wraps
+// around at 32 bits like the generated code does. Division by zero and
+// INT_MIN / -1 trap at run time, so they are never folded.
+//
+// Within a block, loads of a variable that was just stored are forwarded
+// first, which covers globals and anything else left in memory.
+//
+// Returns the number of instructions folded to constants.
+size_t propagateConstants(IRFunction& function);
+
+#endif // CONSTANT_PROPAGATION_H
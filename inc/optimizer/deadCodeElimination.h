@@ -0,0 +1,22 @@
+#ifndef DEAD_CODE_ELIMINATION_H
+#define DEAD_CODE_ELIMINATION_H
+
+#include <cstddef>
+#include "irFunction.h"
+
+// What dead code elimination removed
+struct DeadCodeStats {
+    size_t instructions = 0;
+    size_t blocks = 0;
+};
+
+// Removes the blocks the entry cannot reach, then every instruction whose
+// result is never used. Liveness starts from the instructions with side
+// effects: stores, which only remain for variables other functions can
+// see, terminators, and divisions that may trap. Everything their
+// operands are computed from, through phis as well, is live too, and the
+// rest goes. Temporaries may be assigned more than once, so it works on
+// SSA form and after it.
+DeadCodeStats eliminateDeadCode(IRFunction& function);
+
+#endif // DEAD_CODE_ELIMINATION_H
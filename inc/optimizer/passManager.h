@@ -0,0 +1,147 @@
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "irFunction.h"
+
+// Analyses that are still valid after a pass
+enum class Preserved : uint8_t {
+    Nothing,
+    CFG,        // only instructions changed, blocks and edges are the same
+    All,        // nothing changed
+};
+
+// What running the passes cost and did, summed over the functions they
+// ran on
+struct PassStatistics {
+    struct Pass {
+        std::string name;
+        size_t runs = 0;
+        double seconds = 0;
+        size_t instructionsBefore = 0;
+        size_t instructionsAfter = 0;
+        // Instructions folded, replaced, removed or added, as the pass
+        // counts them
+        size_t changes = 0;
+    };
+    // In pipeline order
+    std::vector<Pass> passes;
+    // Times each analysis was computed
+    std::map<std::string, size_t> analyses;
+
+    // Both sides have to come from the same pipeline
+    PassStatistics& operator+=(const PassStatistics& other);
+    void print(std::ostream& os = std::cout) const;
+};
+
+using AnalysisId = const void*;
+
+// Distinct for every analysis class
+template <typename Analysis>
+AnalysisId analysisId() {
+    static const char id = 0;
+    return &id;
+}
+
+// Analyses of one function, computed on first use and kept until a pass
+// invalidates them. An analysis is registered once with a factory, which
+// may ask for the analyses it is built on.
+class AnalysisManager {
+public:
+    template <typename Analysis>
+    using Factory = std::function<std::unique_ptr<Analysis>(const IRFunction&, AnalysisManager&)>;
+
+    explicit AnalysisManager(const IRFunction& function, PassStatistics* stats = nullptr)
+        : function(function), stats(stats) {}
+
+    template <typename Analysis>
+    const Analysis& get() {
+        return *static_cast<const Analysis*>(get(analysisId<Analysis>()));
+    }
+
+    // Drops the analyses the last pass did not preserve
+    void invalidate(Preserved preserved);
+
+    // Analyses that only look at blocks and edges, like dominators,
+    // survive passes that preserve the CFG
+    template <typename Analysis>
+    static void registerAnalysis(const std::string& name, bool onlyCFG, Factory<Analysis> factory) {
+        registerAnalysis(analysisId<Analysis>(), name, onlyCFG,
+                         [factory](const IRFunction& function, AnalysisManager& analyses) {
+                             return std::shared_ptr<const void>(factory(function, analyses));
+                         });
+    }
+
+private:
+    using ErasedFactory = std::function<std::shared_ptr<const void>(const IRFunction&, AnalysisManager&)>;
+
+    struct Cached {
+        std::shared_ptr<const void> result;
+        bool onlyCFG;
+    };
+
+    const IRFunction& function;
+    PassStatistics* stats;
+    std::unordered_map<AnalysisId, Cached> cache;
+
+    const void* get(AnalysisId id);
+    static void registerAnalysis(AnalysisId id, const std::string& name, bool onlyCFG, ErasedFactory factory);
+};
+
+// What a transform did to a function
+struct PassResult {
+    size_t changes = 0;
+    Preserved preserved = Preserved::All;
+};
+
+// Transforms get the function, its analyses and the counter to number new
+// temporaries from
+using Transform = std::function<PassResult(IRFunction&, AnalysisManager&, uint32_t& nextTemp)>;
+
+// Runs a list of registered transforms over each function, between IR
+// generation and code generation. The built-in passes are
+//   ssa         promote local variables to SSA temporaries
+//   sccp        sparse conditional constant propagation
+//   gvn         dominator-scoped value numbering
+//   dce         dead code and unreachable block elimination
+//   out-of-ssa  lower phis to copies
+// Code generation cannot handle phis, so a pipeline that builds SSA form
+// without leaving it again gets out-of-ssa appended.
+class PassManager {
+public:
+    // Code is generated from the IR as it comes out of the front end unless
+    // a higher level is asked for
+    static constexpr unsigned DefaultLevel = 0;
+
+    // Throws std::invalid_argument for passes that are not registered
+    explicit PassManager(std::vector<std::string> names);
+
+    // -O0 runs nothing, -O1 constant propagation and dead code
+    // elimination, -O2 adds value numbering
+    static PassManager forLevel(unsigned level);
+
+    // Pass names separated by commas
+    static PassManager parse(const std::string& list);
+
+    static void registerPass(const std::string& name, Transform transform);
+    static std::vector<std::string> getRegisteredPasses();
+
+    const std::vector<std::string>& getPasses() const { return names; }
+
+    // Runs every pass on the function, adding what they did to stats
+    void run(IRFunction& function, uint32_t& nextTemp, PassStatistics& stats) const;
+
+private:
+    std::vector<std::string> names;
+    std::vector<Transform> transforms;
+};
+
+#endif // PASS_MANAGER_H
@@ -0,0 +1,25 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include <cstdint>
+#include "irFunction.h"
+#include "dominatorTree.h"
+
+// Promotes the local variables of a function to SSA temporaries
+// (mem2reg). Phis are placed at the iterated dominance frontiers of each
+// variable's stores, then a walk over the dominator tree replaces every
+// load by the value reaching it and drops the loads and stores of the
+// promoted variables. A variable read before any store, like a parameter,
+// is loaded once at the entry. New temporaries are numbered from nextTemp.
+void constructSSA(IRFunction& function, uint32_t& nextTemp);
+// Same, with the dominator tree of the function already at hand
+void constructSSA(IRFunction& function, uint32_t& nextTemp, const DominatorTree& dominators);
+
+// Turns phis back into copies so the code generator never sees them. Each
+// phi gets a fresh temporary that every predecessor copies its incoming
+// value into right before its terminator, and the phi itself becomes a
+// copy out of it. Going through the extra temporary keeps phis that read
+// each other's results correct without ordering the copies.
+void destroySSA(IRFunction& function, uint32_t& nextTemp);
+
+#endif // SSA_H
@@ -0,0 +1,23 @@
+#ifndef VALUE_NUMBERING_H
+#define VALUE_NUMBERING_H
+
+#include <cstddef>
+#include "irFunction.h"
+#include "dominatorTree.h"
+
+// Dominator-scoped hash value numbering over a function in SSA form.
+// Walking the dominator tree, every computation is looked up by opcode,
+// type and operands, with the operands of ADD and MUL in a fixed order,
+// and one already available in a dominating block replaces it. Copies
+// are forwarded and phis whose incoming values are all the same become
+// that value.
+//
+// Loads of variables the function never stores are numbered like any
+// other computation. Variables it does store are only reused within a
+// block, up to the next store, which supplies the value itself.
+//
+// Returns the number of instructions replaced.
+size_t numberValues(IRFunction& function);
+size_t numberValues(IRFunction& function, const DominatorTree& dominators);
+
+#endif // VALUE_NUMBERING_H
@@ -0,0 +1,65 @@
+#ifndef INCREMENTAL_PARSER_H
+#define INCREMENTAL_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "astNode.h"
+#include "astArena.h"
+#include "lexer.h"
+
+// Keeps the AST of one source file across edits. Each update diffs the
+// new text against the previous one, re-lexes and re-parses only the
+// region between the last unchanged function before the edit and the
+// first unchanged function after it, and splices the result into the
+// retained module. Functions outside that region keep their nodes.
+class IncrementalParser {
+public:
+    IncrementalParser() = default;
+    IncrementalParser(const IncrementalParser&) = delete;
+    IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+    // Parses the new version of the source, throws on syntax errors like
+    // Parser does. The module stays valid until the next update.
+    ModuleNode* update(std::string_view text);
+
+    // Replaces length bytes at offset, for callers that already know the
+    // edit and can skip the diff
+    ModuleNode* edit(size_t offset, size_t length, std::string_view replacement);
+
+    ModuleNode* getModule() const { return module; }
+
+    // Functions built by the last update, everything else in the module
+    // was carried over and needs no further work from later stages
+    const std::vector<FunctionNode*>& getDirtyFunctions() const { return dirty; }
+    size_t getFunctionCount() const;
+
+    // Whether the last update replaced anything besides functions, in which
+    // case the bindings of retained functions may be stale
+    bool hasTopLevelChanges() const { return topLevelChanged; }
+
+private:
+    // Top-level item and the bytes of source it was parsed from
+    struct Item {
+        size_t begin;
+        size_t end;
+        ASTNodePtr node;
+    };
+
+    std::string source;
+    std::vector<Item> items;
+    std::vector<FunctionNode*> dirty;
+    bool topLevelChanged = false;
+    ModuleNode* module = nullptr;
+    ASTArena arena;
+    // Arena size right after the last full parse, replaced subtrees are
+    // only reclaimed by the next full parse
+    size_t liveBytes = 0;
+
+    ModuleNode* reparse(size_t prefix, size_t oldChangeEnd, std::string_view text);
+    ModuleNode* parseAll();
+    bool parseRegion(size_t begin, size_t end, bool partial, std::vector<Item>& out);
+    ModuleNode* finish();
+};
+
+#endif // INCREMENTAL_PARSER_H
@@ -1,26 +1,94 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <mutex>
 #include <vector>
 #include "astNode.h"
+#include "astArena.h"
 #include "lexer.h"
+#include "tokenStream.h"
+
+class ThreadPool;
+class LazyBodyParser;
 
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens);
+    // Borrows the tokens, they have to outlive the parser. Nodes are
+    // allocated from the arena, which owns the resulting tree.
+    Parser(const std::vector<Token>& tokens, ASTArena& arena);
+    // Pulls tokens from the stream as parsing goes
+    Parser(TokenStream& stream, ASTArena& arena);
 
+    // Parses the whole input into a ModuleNode
     ASTNodePtr parse();
 
+    // Same result as parse(), but top-level functions are found by a
+    // brace-matching pre-scan and parsed on the pool, each worker into an
+    // arena that is merged into this parser's arena afterwards. Streams
+    // are parsed serially.
+    ASTNodePtr parse(ThreadPool& pool);
+
+    // Only brace-match function bodies and record their token range, the
+    // body is parsed by bodies when it is first asked for. Ignored for
+    // streams, whose tokens do not outlive their window.
+    void setLazyBodies(LazyBodyParser* bodies) { lazyBodies = bodies; }
+
+    // Parses a single top-level item, nullptr at the end of the input
+    ASTNodePtr parseItem();
+
+    // Next unread token, only meaningful when parsing a token vector
+    const Token* position() const { return cursor; }
+
 private:
-    std::vector<Token> tokens;
-    int current = 0;
+    friend class LazyBodyParser;
+    Parser(const Token* begin, const Token* end, ASTArena& arena);
+
+    ASTArena& arena;
+    // Params and body nodes collected so far, shared by nested functions
+    std::vector<ASTNodePtr> scratch;
+    // Operand and operator stacks of the expression parser, shared by
+    // nested (parenthesized) expressions
+    std::vector<ASTNodePtr> operands;
+    std::vector<TokenType> operators;
+
+    LazyBodyParser* lazyBodies = nullptr;
+    TokenStream* stream = nullptr;
+    const Token* windowBegin = nullptr;
+    const Token* cursor = nullptr;
+    const Token* windowEnd = nullptr;
+
+    // Copy of the last consumed token once its window has been replaced
+    Token lastToken{"", TokenType::End};
 
     bool match(TokenType type);
-    const Token peek() const;
+    const Token& peek();
+    const Token& previous() const;
     void advance();
+    bool refill();
+    ASTNodeList finishList(size_t start);
+    void parseItems();
+    ASTNodeList parseBody();
     ASTNodePtr parseExpression();
-    ASTNodePtr parseTerm();
+    ASTNodePtr parseBinaryExpression();
     ASTNodePtr parseFactor();
+    void reduce();
+};
+
+// Parses the bodies skipped by a lazy Parser when they are first needed,
+// into the arena of the tree. Bodies may be demanded from several threads
+// at once, though not the same function from two of them.
+class LazyBodyParser : public BodyParser {
+public:
+    explicit LazyBodyParser(ASTArena& arena) : arena(arena) {}
+
+    ASTNodeList parseBody(const Token* begin, const Token* end) override;
+
+    size_t getParsedCount() const { return parsedCount; }
+
+private:
+    ASTArena& arena;
+    std::mutex mutex;
+    size_t parsedCount = 0;
 };
 
-#endif // PARSER_H
\ No newline at end of file
+#endif // PARSER_H
@@ -0,0 +1,54 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for the parallel compiler phases. The thread
+// calling parallelFor() takes part as worker 0, so a pool of size 1 runs
+// everything inline.
+class ThreadPool {
+public:
+    // 0 picks the number of hardware threads
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Calls task(index, worker) for every index in [0, count) and returns
+    // once all of them have finished. Indices are handed out dynamically,
+    // worker is in [0, size()) and unique among concurrently running tasks.
+    // If tasks throw, the remaining indices are skipped and the first
+    // exception is rethrown here.
+    void parallelFor(size_t count, const std::function<void(size_t index, unsigned worker)>& task);
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    // State of the parallelFor() in flight
+    const std::function<void(size_t, unsigned)>* task = nullptr;
+    size_t taskCount = 0;
+    std::atomic<size_t> nextIndex{0};
+    unsigned activeWorkers = 0;
+    std::exception_ptr failure;
+
+    void workerLoop(unsigned worker);
+    void runTasks(unsigned worker);
+};
+
+#endif // THREAD_POOL_H
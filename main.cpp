@@ -1,78 +1,323 @@
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <chrono>
+#include <thread>
+#include <sys/stat.h>
 #include "lexer.h"
+#include "sourceBuffer.h"
+#include "tokenStream.h"
+#include "threadPool.h"
 #include "parser.h"
+#include "incrementalParser.h"
+#include "flatAst.h"
+#include "astPrinter.h"
 #include "semanticAnalyzer.h"
 #include "irGenerator.h"
 #include "codeGenerator.h"
+#include "moduleCompiler.h"
+#include "passManager.h"
+#include "irFile.h"
 
 
-void generateDotFile(const ASTNodePtr& root, const std::string& filename) {
-    std::ofstream file(filename);
-    file << "digraph G {\n";
-    file << root->toDot();
-    file << "}\n";
-    file.close();
+void dumpAST(ASTNodePtr root, ASTDumpFormat format) {
+    std::vector<char> buffer(1 << 20);
+    std::ofstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(format == ASTDumpFormat::Dot ? "ast.dot" : "ast.json");
+    ASTPrinter(file).write(root, format);
 }
 
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) {
-        throw std::runtime_error("Could not open file");
+void printTokens(const std::vector<Token>& tokens) {
+    for (const auto& token : tokens) {
+        std::cout << "Token: " << token.value << ", Type: " << token.type << std::endl;
     }
+}
+
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+struct Options {
+    std::string inputFile;
+    bool stream = false;
+    bool watch = false;
+    bool lazy = false;
+    bool flat = false;
+    bool dumpAST = false;
+    ASTDumpFormat dumpFormat = ASTDumpFormat::Dot;
+    unsigned threads = 1;
+    unsigned optimizationLevel = PassManager::DefaultLevel;
+    std::string passes;
+    bool passStats = false;
+    std::string emitIR;
+    bool fromIR = false;
+};
+
+void printUsage() {
+    std::cerr << "Usage: ./main [options] <input file>" << std::endl;
+    std::cerr << "  --stream               Lex the input in chunks while parsing, '-' reads stdin" << std::endl;
+    std::cerr << "  --watch                Recompile whenever the input changes, reparsing only edited functions" << std::endl;
+    std::cerr << "  --lazy                 Only brace-match function bodies while parsing, parse them when first used" << std::endl;
+    std::cerr << "  --flat-ast             Run semantic analysis and IR generation over the flat AST" << std::endl;
+    std::cerr << "  --dump-ast[=dot|json]  Write the AST to ast.dot or ast.json" << std::endl;
+    std::cerr << "  -j, --threads          Number of threads for the parallel phases, 0 for all cores" << std::endl;
+    std::cerr << "  -O0, -O1, -O2          Optimization level, -O0 (no IR passes) by default" << std::endl;
+    std::cerr << "  --passes=a,b,...       Run these IR passes instead of a level's, out of";
+    for (const auto& pass : PassManager::getRegisteredPasses()) {
+        std::cerr << " " << pass;
+    }
+    std::cerr << std::endl;
+    std::cerr << "  --pass-stats           Print the time and instruction counts of every pass" << std::endl;
+    std::cerr << "  --emit-ir=<file>       Write the IR after the passes to a binary IR file" << std::endl;
+    std::cerr << "  --from-ir              The input is a binary IR file, only generate code for it" << std::endl;
 }
 
-void printTokens(const std::vector<Token>& tokens) {
-    for (const auto& token : tokens) {
-        std::cout << "Token: " << token.value << ", Type: " << token.type << std::endl;
+// Thread count of -j, only digits so "abc" or "-1" are rejected
+bool parseThreads(const std::string& text, unsigned& threads) {
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    threads = std::stoul(text);
+    return true;
+}
+
+bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--dump-ast" || arg == "--dump-ast=dot") {
+            options.dumpAST = true;
+            options.dumpFormat = ASTDumpFormat::Dot;
+        } else if (arg == "--dump-ast=json") {
+            options.dumpAST = true;
+            options.dumpFormat = ASTDumpFormat::Json;
+        } else if (arg == "--flat-ast") {
+            options.flat = true;
+        } else if (arg == "--lazy") {
+            options.lazy = true;
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "-j" || arg == "--threads") {
+            if (++i == argc || !parseThreads(argv[i], options.threads)) return false;
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            if (!parseThreads(arg.substr(10), options.threads)) return false;
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            options.optimizationLevel = arg[2] - '0';
+        } else if (arg.compare(0, 9, "--passes=") == 0) {
+            options.passes = arg.substr(9);
+        } else if (arg == "--pass-stats") {
+            options.passStats = true;
+        } else if (arg.compare(0, 10, "--emit-ir=") == 0) {
+            options.emitIR = arg.substr(10);
+        } else if (arg == "--from-ir") {
+            options.fromIR = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        } else if (options.inputFile.empty()) {
+            options.inputFile = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.inputFile.empty() && !(options.watch && options.stream)
+        && !(options.fromIR && (options.watch || options.stream));
+}
+
+
+void printCode(const CodeGenerator& codeGen) {
+    codeGen.printCode();
+    codeGen.disassembleCode();
+}
+
+void generate(IRGenerator& irGen, const PassManager& passes, const Options& options) {
+    PassStatistics stats;
+    for (auto& function : irGen.getFunctions()) {
+        passes.run(function, irGen.getTempCounter(), stats);
+    }
+    irGen.printIR();
+    if (options.passStats) {
+        stats.print();
+    }
+    if (!options.emitIR.empty()) {
+        IRFileWriter writer;
+        writer.addUnit(irGen);
+        writer.write(options.emitIR);
+    }
+
+    // Generate Code
+    CodeGenerator codeGen(irGen.getGlobalCount());
+    for (const auto& function : irGen.getFunctions()) {
+        codeGen.generateCode(function);
+    }
+    printCode(codeGen);
+}
+
+
+// Generates code straight from a binary IR file, skipping the front end
+// and the passes. Each unit gets its own code generator like it did when
+// the file was written.
+int compileIR(const Options& options) {
+    try {
+        IRFile file(options.inputFile);
+        CodeGenerator codeGen;
+        for (size_t u = 0; u < file.getUnitCount(); u++) {
+            const IRFileUnit& unit = file.getUnit(u);
+            CodeGenerator unitCode(unit.globalCount);
+            for (size_t f = 0; f < unit.functionCount; f++) {
+                const IRFileFunction& function = file.getFunction(unit, f);
+                unitCode.generateCode(file.getInstructions(function), function.instructionCount);
+            }
+            codeGen.append(unitCode);
+        }
+        printCode(codeGen);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+// Polls the input and recompiles it on every change. The front end only
+// redoes the functions touched by the edit.
+int watch(const Options& options, const PassManager& passes) {
+    IncrementalParser parser;
+    struct timespec lastModified = {};
+    off_t lastSize = -1;
+
+    for (;;) {
+        struct stat info;
+        bool changed = stat(options.inputFile.c_str(), &info) == 0
+            && (info.st_mtim.tv_sec != lastModified.tv_sec || info.st_mtim.tv_nsec != lastModified.tv_nsec
+                || info.st_size != lastSize);
+        if (!changed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+        lastModified = info.st_mtim;
+        lastSize = info.st_size;
+
+        try {
+            SourceBuffer source(options.inputFile);
+            ModuleNode* module = parser.update(source.view());
+            std::cout << "Reparsed " << parser.getDirtyFunctions().size() << " of " << parser.getFunctionCount()
+                      << " functions" << std::endl;
+
+            // Retained functions keep their bindings unless the globals
+            // they may refer to changed
+            SemanticAnalyzer semanticAnalyzer;
+            if (parser.hasTopLevelChanges()) {
+                semanticAnalyzer.analyze(module);
+            } else {
+                semanticAnalyzer.analyze(*module, parser.getDirtyFunctions());
+            }
+
+            IRGenerator irGen(semanticAnalyzer.getGlobalCount());
+            irGen.generateIR(module);
+            generate(irGen, passes, options);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
     }
 }
 
 
 int main(int argc, char* argv[]) {
 
-    if(argc != 2) {
+    Options options;
+    if(!parseArguments(argc, argv, options)) {
         std::cerr << "Incorrect usage" << std::endl;
-        std::cerr << "Usage: ./main <input file>" << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    std::unique_ptr<PassManager> passes;
+    try {
+        passes.reset(new PassManager(options.passes.empty() ? PassManager::forLevel(options.optimizationLevel)
+                                                            : PassManager::parse(options.passes)));
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        printUsage();
         return 1;
     }
 
-    std::string sourceCode = readFile(argv[1]);
-    std::vector<Token> tokens = tokenize(sourceCode);
+    if (options.watch) {
+        return watch(options, *passes);
+    }
+    if (options.fromIR) {
+        return compileIR(options);
+    }
+
+    ThreadPool pool(options.threads);
+
+    // Tokens view into the mapped file, so it stays mapped for the whole compile
+    std::unique_ptr<SourceBuffer> source;
+    std::unique_ptr<ChunkedLexer> stream;
+    std::vector<Token> tokens;
+    if (options.stream) {
+        stream.reset(new ChunkedLexer(options.inputFile));
+    } else {
+        source.reset(new SourceBuffer(options.inputFile));
+        tokens = pool.size() > 1 ? tokenize(source->view(), pool) : tokenize(source->view());
 
-    printTokens(tokens);
-    std::cout << "Tokenization successful!" << std::endl;
+        printTokens(tokens);
+        std::cout << "Tokenization successful!" << std::endl;
+    }
 
-    Parser parser(tokens);
+    // Owns the AST, the whole tree is released with it
+    ASTArena arena;
+    Parser parser = options.stream ? Parser(*stream, arena) : Parser(tokens, arena);
+    LazyBodyParser bodies(arena);
+    if (options.lazy) {
+        parser.setLazyBodies(&bodies);
+    }
     ASTNodePtr ast;
     try {
-        ast = parser.parse();
+        ast = parser.parse(pool);
         std::cout << "Parsing successful!" << std::endl;
-        generateDotFile(ast, "ast.dot");
+        if (options.dumpAST) {
+            dumpAST(ast, options.dumpFormat);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
+        return 1;
     }
 
-    SemanticAnalyzer semanticAnalyzer;
-    ast->accept(semanticAnalyzer);
-
-    // Generate Intermediate Representations
-    IRGenerator irGen;
-    irGen.generateIR(ast);
-    irGen.printIR();
-    std::vector<IRInstruction> irInstructions = irGen.getIRInstructions();
-
-    // Generate Code
-    CodeGenerator codeGen;
-    codeGen.generateCode(irInstructions);
-    codeGen.printCode();
-    codeGen.disassembleCode();
+    // Lazy function bodies are parsed from here on, so syntax errors in
+    // them show up now
+    try {
+        if (options.flat) {
+            SemanticAnalyzer semanticAnalyzer;
+            FlatAST flatAst = FlatAST::build(ast);
+            semanticAnalyzer.analyze(flatAst);
+            IRGenerator irGen(semanticAnalyzer.getGlobalCount());
+            irGen.generateIR(flatAst);
+            generate(irGen, *passes, options);
+        } else {
+            // Functions are compiled independently, the output does not
+            // depend on the number of threads
+            ModuleCompiler compiler(pool, *passes);
+            compiler.compile(*static_cast<ModuleNode*>(ast));
+            compiler.printIR();
+            if (options.passStats) {
+                compiler.getStats().print();
+            }
+            if (!options.emitIR.empty()) {
+                IRFileWriter writer;
+                for (size_t unit = 0; unit < compiler.getUnitCount(); unit++) {
+                    writer.addUnit(compiler.getIR(unit));
+                }
+                writer.write(options.emitIR);
+            }
+            printCode(compiler.getCode());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (options.lazy) {
+        std::cout << "Parsed " << bodies.getParsedCount() << " function bodies on demand" << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
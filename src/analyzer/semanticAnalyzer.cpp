@@ -1,76 +1,109 @@
 #include "semanticAnalyzer.h"
 #include <iostream>
+#include <unordered_set>
 
 
+SemanticAnalyzer::SemanticAnalyzer(const SemanticAnalyzer& module, uint32_t visibleGlobals, std::ostream& errors)
+    : errors(&errors) {
+    symbolTable.setEnclosingGlobals(&module.symbolTable, visibleGlobals);
+}
+
 void SemanticAnalyzer::analyze(ASTNodePtr root) {
-    root->accept(*this);
+    dispatch(*root);
+}
+
+void SemanticAnalyzer::analyze(ModuleNode& module, const std::vector<FunctionNode*>& functions) {
+    std::unordered_set<ASTNodePtr> selected(functions.begin(), functions.end());
+    for (const auto& item : module.getItems()) {
+        if (item->getNodeType() != ASTNodeType::FunctionDeclaration || selected.count(item)) {
+            dispatch(*item);
+        }
+    }
 }
 
 void SemanticAnalyzer::visit(NumberNode& node) {
-    // Nothing for now
+    node.setDataType(DataType::Int);
 }
 
 void SemanticAnalyzer::visit(IdentifierNode& node) {
     SymbolInfo symbolInfo;
-    if (!symbolTable.lookup(node.getName(), symbolInfo)) {
-        std::cerr << "Error: Identifier " << node.getName() << " not found" << std::endl;
+    if (!symbolTable.lookup(node.getSymbol(), symbolInfo)) {
+        *errors << "Error: Identifier " << node.getName() << " not found" << std::endl;
+        return;
     }
+    node.bind(symbolInfo.binding);
+    node.setDataType(symbolInfo.binding.type);
+}
+
+static bool isArithmeticOperand(ASTNodePtr node) {
+    return node->getNodeType() == ASTNodeType::Number || node->getNodeType() == ASTNodeType::Identifier
+        || node->getNodeType() == ASTNodeType::BinaryExpression;
 }
 
 void SemanticAnalyzer::visit(BinaryOperatorNode& node) {
-    node.getLeft()->accept(*this);
-    node.getRight()->accept(*this);
+    // Operator chains are left-deep, walk down the left spine in a loop
+    // rather than recursing once per operator
+    std::vector<BinaryOperatorNode*> chain{&node};
+    while (auto left = nodeCast<BinaryOperatorNode>(chain.back()->getLeft())) {
+        chain.push_back(left);
+    }
 
-    if (node.getLeft()->getNodeType() != ASTNodeType::Number && node.getLeft()->getNodeType() != ASTNodeType::Identifier) {
+    ASTNodePtr first = chain.back()->getLeft();
+    dispatch(*first);
+    if (!isArithmeticOperand(first)) {
         reportError("Left side of binary operator is not a number or identifier");
     }
-    if (node.getRight()->getNodeType() != ASTNodeType::Number && node.getRight()->getNodeType() != ASTNodeType::Identifier) {
-        reportError("Right side of binary operator is not a number or identifier");
+
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        ASTNodePtr right = (*it)->getRight();
+        dispatch(*right);
+        if (!isArithmeticOperand(right)) {
+            reportError("Right side of binary operator is not a number or identifier");
+        }
+        // Arithmetic is on ints, bool operands are widened
+        (*it)->setDataType(DataType::Int);
     }
 }
 
 void SemanticAnalyzer::visit(EqualsNode& node) {
-    node.getLeft()->accept(*this);
-    node.getRight()->accept(*this);
+    dispatch(*node.getLeft());
+    dispatch(*node.getRight());
 
     if (node.getLeft()->getNodeType() != ASTNodeType::Identifier) {
         reportError("Left side of assignment must be an identifier");
     }
+    node.setDataType(node.getRight()->getDataType());
 }
 
 void SemanticAnalyzer::visit(LetNode& node) {
-    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node.getIdentifier());
+    auto identifierNode = nodeCast<IdentifierNode>(node.getIdentifier());
     if (!identifierNode) {
         reportError("Left side of let statement must be an identifier");
         return;
     }
 
-    // Determine the data type of the value
-    std::string dataType;
-    if (node.getValue()->getNodeType() == ASTNodeType::Number) {
-        dataType = "int";
-    } else if (node.getValue()->getNodeType() == ASTNodeType::Boolean) {
-        dataType = "bool";
-    } else if (node.getValue()->getNodeType() == ASTNodeType::Identifier) {
-        node.getValue()->accept(*this);
-        dataType = "unknown";
-    } else if (node.getValue()->getNodeType() == ASTNodeType::BinaryExpression) {
-        dataType = "unknown";
-    } else {
+    ASTNodeType valueKind = node.getValue()->getNodeType();
+    if (valueKind != ASTNodeType::Number && valueKind != ASTNodeType::Boolean && valueKind != ASTNodeType::Identifier
+        && valueKind != ASTNodeType::BinaryExpression) {
         reportError("Unsupported data type in let statement");
         return;
     }
 
-    symbolTable.insert(identifierNode->getName(), SymbolType::VARIABLE, dataType);
+    // The value is checked before the name is declared, so it refers to
+    // any outer variable of the same name, and gives the variable its type
+    dispatch(*node.getValue());
+    DataType dataType = node.getValue()->getDataType();
 
-    node.getValue()->accept(*this);
+    const SymbolInfo& info = symbolTable.insert(identifierNode->getSymbol(), SymbolType::VARIABLE, dataType);
+    identifierNode->bind(info.binding);
+    identifierNode->setDataType(dataType);
 }
 
 void SemanticAnalyzer::visit(FunctionNode& node) {
     symbolTable.enterScope();
 
     for (const auto& param : node.getParams()) {
-        param->accept(*this);
+        dispatch(*param);
 
         // Params can only be identifiers
         if (param->getNodeType() != ASTNodeType::Identifier) {
@@ -79,22 +112,143 @@ void SemanticAnalyzer::visit(FunctionNode& node) {
         }
 
         if (param->getNodeType() == ASTNodeType::Identifier) {
-            auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(param);
-            symbolTable.insert(identifierNode->getName(), SymbolType::PARAMETER, "int");
+            auto identifierNode = nodeCast<IdentifierNode>(param);
+            identifierNode->bind(symbolTable.insert(identifierNode->getSymbol(), SymbolType::PARAMETER, DataType::Int).binding);
+            identifierNode->setDataType(DataType::Int);
         }
     }
 
     for (const auto& bodyNode : node.getBodyNodes()) {
-        bodyNode->accept(*this);
+        dispatch(*bodyNode);
     }
 
     symbolTable.exitScope();
 }
 
 void SemanticAnalyzer::visit(BooleanLiteralNode& node) {
-    // Nothing for now
+    node.setDataType(DataType::Bool);
+}
+
+void SemanticAnalyzer::visit(ModuleNode& node) {
+    for (const auto& item : node.getItems()) {
+        dispatch(*item);
+    }
+}
+
+void SemanticAnalyzer::analyze(FlatAST& ast) {
+    analyzeFlat(ast, ast.root());
+}
+
+static bool isArithmeticOperand(ASTNodeType kind) {
+    return kind == ASTNodeType::Number || kind == ASTNodeType::Identifier || kind == ASTNodeType::BinaryExpression;
+}
+
+// Mirrors the visit methods above node for node, reading the arrays
+// instead of following pointers
+void SemanticAnalyzer::analyzeFlat(FlatAST& ast, FlatNodeId node) {
+    switch (ast.kind(node)) {
+        case ASTNodeType::Number:
+            ast.setType(node, DataType::Int);
+            break;
+        case ASTNodeType::Boolean:
+            ast.setType(node, DataType::Bool);
+            break;
+
+        case ASTNodeType::Identifier: {
+            SymbolInfo symbolInfo;
+            if (!symbolTable.lookup(ast.payload(node), symbolInfo)) {
+                *errors << "Error: Identifier " << StringInterner::global().lookup(ast.payload(node)) << " not found" << std::endl;
+                break;
+            }
+            ast.bind(node, symbolInfo.binding);
+            ast.setType(node, symbolInfo.binding.type);
+            break;
+        }
+
+        case ASTNodeType::BinaryExpression: {
+            FlatNodeId left = ast.firstChild(node);
+            FlatNodeId right = ast.nextSibling(left);
+            if (!ast.isArithmetic(node)) {
+                analyzeFlat(ast, left);
+                analyzeFlat(ast, right);
+                if (ast.kind(left) != ASTNodeType::Identifier) {
+                    reportError("Left side of assignment must be an identifier");
+                }
+                ast.setType(node, ast.type(right));
+                break;
+            }
+
+            std::vector<FlatNodeId> chain{node};
+            while (ast.isArithmetic(ast.firstChild(chain.back()))) {
+                chain.push_back(ast.firstChild(chain.back()));
+            }
+
+            FlatNodeId first = ast.firstChild(chain.back());
+            analyzeFlat(ast, first);
+            if (!isArithmeticOperand(ast.kind(first))) {
+                reportError("Left side of binary operator is not a number or identifier");
+            }
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                FlatNodeId operand = ast.nextSibling(ast.firstChild(*it));
+                analyzeFlat(ast, operand);
+                if (!isArithmeticOperand(ast.kind(operand))) {
+                    reportError("Right side of binary operator is not a number or identifier");
+                }
+                ast.setType(*it, DataType::Int);
+            }
+            break;
+        }
+
+        case ASTNodeType::VariableDeclaration: {
+            FlatNodeId identifier = ast.firstChild(node);
+            FlatNodeId value = ast.nextSibling(identifier);
+            if (ast.kind(identifier) != ASTNodeType::Identifier) {
+                reportError("Left side of let statement must be an identifier");
+                break;
+            }
+
+            ASTNodeType valueKind = ast.kind(value);
+            if (valueKind != ASTNodeType::Number && valueKind != ASTNodeType::Boolean && valueKind != ASTNodeType::Identifier
+                && valueKind != ASTNodeType::BinaryExpression) {
+                reportError("Unsupported data type in let statement");
+                break;
+            }
+
+            analyzeFlat(ast, value);
+            ast.bind(identifier, symbolTable.insert(ast.payload(identifier), SymbolType::VARIABLE, ast.type(value)).binding);
+            ast.setType(identifier, ast.type(value));
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration: {
+            symbolTable.enterScope();
+
+            FlatNodeId child = ast.firstChild(node);
+            for (uint32_t i = 0; i < ast.function(node).paramCount; i++, child = ast.nextSibling(child)) {
+                analyzeFlat(ast, child);
+                if (ast.kind(child) != ASTNodeType::Identifier) {
+                    reportError("Function parameters must be identifiers");
+                    return;
+                }
+                ast.bind(child, symbolTable.insert(ast.payload(child), SymbolType::PARAMETER, DataType::Int).binding);
+                ast.setType(child, DataType::Int);
+            }
+            for (; child != NoFlatNode; child = ast.nextSibling(child)) {
+                analyzeFlat(ast, child);
+            }
+
+            symbolTable.exitScope();
+            break;
+        }
+
+        case ASTNodeType::Module:
+            for (FlatNodeId item = ast.firstChild(node); item != NoFlatNode; item = ast.nextSibling(item)) {
+                analyzeFlat(ast, item);
+            }
+            break;
+    }
 }
 
 void SemanticAnalyzer::reportError(const std::string& errorMessage) {
-    std::cerr << "Error: " << errorMessage << std::endl;
+    *errors << "Error: " << errorMessage << std::endl;
 }
\ No newline at end of file
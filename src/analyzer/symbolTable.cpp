@@ -1,48 +1,103 @@
 #include "symbolTable.h"
 
 
+SymbolTable::SymbolTable() : entries(64) {
+    enterScope();
+}
+
 void SymbolTable::enterScope() {
-    scopeStack.emplace_back();
-    currentScope = scopeStack.back();
+    // A scope directly below the globals is a function body, its frame
+    // starts out empty
+    if (scopeMarks.size() == 1) {
+        frameSlots = 0;
+    }
+    scopeMarks.push_back(static_cast<uint32_t>(declarations.size()));
 }
 
 void SymbolTable::exitScope() {
-    if (!scopeStack.empty()) {
-        scopeStack.pop_back();
-        if (!scopeStack.empty()) {
-            currentScope = scopeStack.back();
-        } else {
-            currentScope = std::unordered_map<std::string, SymbolInfo>();
-            throw std::runtime_error("No scope to exit");
-        }
+    if (scopeMarks.size() == 1) {
+        throw std::runtime_error("No scope to exit");
+    }
+
+    uint32_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    while (declarations.size() > mark) {
+        const Declaration& declaration = declarations.back();
+        find(declaration.name).declaration = declaration.shadowed;
+        declarations.pop_back();
     }
 }
 
-void SymbolTable::insert(const std::string& name, SymbolType type, const std::string& dataType) {
-    if(currentScope.find(name) != currentScope.end()) {
-        throw std::runtime_error("Symbol '" + name + "' already declared in the current scope");
+const SymbolInfo& SymbolTable::insert(SymbolId name, SymbolType type, DataType dataType) {
+    if (2 * (usedEntries + 1) > entries.size()) {
+        grow();
     }
-    SymbolInfo s_info = {type, dataType};
-    currentScope.insert({name, s_info});
+    Entry& entry = find(name);
+    uint32_t depth = static_cast<uint32_t>(scopeMarks.size() - 1);
+    if (entry.declaration != NoDeclaration && declarations[entry.declaration].depth == depth) {
+        throw std::runtime_error("Symbol '" + std::string(StringInterner::global().lookup(name)) + "' already declared in the current scope");
+    }
+    if (entry.name == InvalidSymbol) {
+        entry.name = name;
+        usedEntries++;
+    }
+
+    Binding binding;
+    binding.global = depth == 0;
+    binding.slot = binding.global ? globalSlots++ : frameSlots++;
+    binding.type = dataType;
+    declarations.push_back(Declaration{SymbolInfo{type, binding}, name, depth, entry.declaration});
+    entry.declaration = static_cast<uint32_t>(declarations.size() - 1);
+    return declarations.back().info;
 }
 
-bool SymbolTable::lookup(const std::string& name, SymbolInfo& info) {
-    auto scope = scopeStack.rbegin();
+bool SymbolTable::lookup(SymbolId name, SymbolInfo& info) const {
+    const Entry* entry = find(name);
+    if (!entry || entry->declaration == NoDeclaration) {
+        // Global slots are numbered in declaration order, so the slot tells
+        // whether the global was declared early enough to be visible
+        return enclosing && enclosing->lookup(name, info) && info.binding.slot < enclosingVisible;
+    }
+    info = declarations[entry->declaration].info;
+    return true;
+}
 
-    while (scope != scopeStack.rend()) {
-        auto it = scope->find(name);
-        if(it != scope->end()) {
-            info = it->second;
-            return true;
-        }
-        ++scope;
+void SymbolTable::setEnclosingGlobals(const SymbolTable* globals, uint32_t visibleGlobals) {
+    enclosing = globals;
+    enclosingVisible = visibleGlobals;
+}
+
+// Ids are dense small integers, a multiplicative hash spreads them out
+static size_t slotFor(SymbolId name, size_t mask) {
+    return (static_cast<size_t>(name) * 0x9E3779B97F4A7C15ull >> 17) & mask;
+}
+
+// Entry of name, or the empty entry where it would go
+SymbolTable::Entry& SymbolTable::find(SymbolId name) {
+    size_t mask = entries.size() - 1;
+    size_t i = slotFor(name, mask);
+    while (entries[i].name != name && entries[i].name != InvalidSymbol) {
+        i = (i + 1) & mask;
     }
+    return entries[i];
+}
 
-    auto it = currentScope.find(name);
-    if(it != currentScope.end()) {
-        info = it->second;
-        return true;
+const SymbolTable::Entry* SymbolTable::find(SymbolId name) const {
+    size_t mask = entries.size() - 1;
+    size_t i = slotFor(name, mask);
+    while (entries[i].name != name) {
+        if (entries[i].name == InvalidSymbol) return nullptr;
+        i = (i + 1) & mask;
+    }
+    return &entries[i];
+}
+
+void SymbolTable::grow() {
+    std::vector<Entry> old(entries.size() * 2);
+    old.swap(entries);
+    for (const Entry& entry : old) {
+        if (entry.name != InvalidSymbol) {
+            find(entry.name) = entry;
+        }
     }
-    
-    return false;
 }
@@ -0,0 +1,35 @@
+#include "astArena.h"
+#include <cstdint>
+
+// Blocks double in size up to this, so deep trees need few of them
+static constexpr size_t maxBlockSize = 1024 * 1024;
+
+
+void* ASTArena::allocate(size_t size, size_t align) {
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(align - 1);
+    if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+        size_t blockSize = nextBlockSize;
+        if (blockSize < size + align) blockSize = size + align;
+        if (nextBlockSize < maxBlockSize) nextBlockSize *= 2;
+
+        blocks.emplace_back(new char[blockSize]);
+        cursor = blocks.back().get();
+        limit = cursor + blockSize;
+        aligned = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(align - 1);
+    }
+
+    cursor = reinterpret_cast<char*>(aligned + size);
+    totalBytes += size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void ASTArena::adopt(ASTArena&& other) {
+    for (auto& block : other.blocks) {
+        blocks.push_back(std::move(block));
+    }
+    totalBytes += other.totalBytes;
+
+    other.blocks.clear();
+    other.cursor = other.limit = nullptr;
+    other.totalBytes = 0;
+}
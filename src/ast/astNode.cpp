@@ -36,3 +36,8 @@ void FunctionNode::accept(ASTVisitor& visitor) {
 void BooleanLiteralNode::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
+
+// ModuleNode implementation
+void ModuleNode::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
@@ -0,0 +1,156 @@
+#include "astPrinter.h"
+#include <ostream>
+
+static const char* tokenTypeName(TokenType tokenType) {
+    switch (tokenType) {
+        case TokenType::Number: return "Number";
+        case TokenType::Identifier: return "Identifier";
+        case TokenType::Equals: return "Equals";
+        case TokenType::OpenParen: return "OpenParen";
+        case TokenType::ClosedParen: return "ClosedParen";
+        case TokenType::OpenBracket: return "OpenBracket";
+        case TokenType::ClosedBracket: return "ClosedBracket";
+        case TokenType::Add: return "Add";
+        case TokenType::Subtract: return "Subtract";
+        case TokenType::Multiply: return "Multiply";
+        case TokenType::Divide: return "Divide";
+        case TokenType::Let: return "Let";
+        case TokenType::Keyword: return "Keyword";
+        case TokenType::BooleanLiteral: return "BooleanLiteral";
+        case TokenType::End: return "End";
+    }
+    return "";
+}
+
+static const char* nodeTypeName(ASTNodeType nodeType) {
+    switch (nodeType) {
+        case ASTNodeType::VariableDeclaration: return "VariableDeclaration";
+        case ASTNodeType::FunctionDeclaration: return "FunctionDeclaration";
+        case ASTNodeType::BinaryExpression: return "BinaryExpression";
+        case ASTNodeType::Identifier: return "Identifier";
+        case ASTNodeType::Number: return "Number";
+        case ASTNodeType::Boolean: return "Boolean";
+        case ASTNodeType::Module: return "Module";
+    }
+    return "";
+}
+
+void ASTPrinter::write(ASTNodePtr root, ASTDumpFormat format) {
+    if (format == ASTDumpFormat::Dot) {
+        writeDot(root);
+    } else {
+        writeJson(root);
+    }
+}
+
+// Replaces children with the children of node, in source order
+void ASTPrinter::collectChildren(ASTNodePtr node) {
+    children.clear();
+    if (auto module = nodeCast<ModuleNode>(node)) {
+        children.assign(module->getItems().begin(), module->getItems().end());
+    } else if (auto function = nodeCast<FunctionNode>(node)) {
+        children.assign(function->getParams().begin(), function->getParams().end());
+        ASTNodeList body = function->getBodyNodes();
+        children.insert(children.end(), body.begin(), body.end());
+    } else if (auto let = nodeCast<LetNode>(node)) {
+        children = {let->getIdentifier(), let->getValue()};
+    } else if (auto binary = nodeCast<BinaryOperatorNode>(node)) {
+        children = {binary->getLeft(), binary->getRight()};
+    } else if (auto equals = nodeCast<EqualsNode>(node)) {
+        children = {equals->getLeft(), equals->getRight()};
+    }
+}
+
+void ASTPrinter::writeLabel(ASTNodePtr node) {
+    if (auto number = nodeCast<NumberNode>(node)) {
+        os << number->getValue();
+    } else if (auto identifier = nodeCast<IdentifierNode>(node)) {
+        os << identifier->getName();
+    } else if (auto function = nodeCast<FunctionNode>(node)) {
+        os << function->getName();
+    } else if (auto boolean = nodeCast<BooleanLiteralNode>(node)) {
+        os << (boolean->getValue() ? "true" : "false");
+    } else if (nodeCast<ModuleNode>(node)) {
+        os << "Module";
+    } else {
+        os << tokenTypeName(node->getTokenType());
+    }
+}
+
+void ASTPrinter::writeDot(ASTNodePtr root) {
+    os << "digraph G {\n";
+    // Ids are handed out when a node is first named, by its parent's edge
+    uint32_t nextId = 1;
+    std::vector<std::pair<ASTNodePtr, uint32_t>> pending{{root, 0}};
+    while (!pending.empty()) {
+        ASTNodePtr node = pending.back().first;
+        uint32_t id = pending.back().second;
+        pending.pop_back();
+
+        os << "node" << id << " [label=\"";
+        writeLabel(node);
+        os << "\"];\n";
+
+        collectChildren(node);
+        uint32_t firstChild = nextId;
+        for (size_t i = 0; i < children.size(); i++) {
+            os << "node" << id << " -> node" << nextId++ << ";\n";
+        }
+        for (size_t i = children.size(); i-- > 0;) {
+            pending.emplace_back(children[i], firstChild + i);
+        }
+    }
+    os << "}\n";
+}
+
+void ASTPrinter::writeJsonFields(ASTNodePtr node, uint32_t id) {
+    os << "{\"id\":" << id << ",\"kind\":\"" << nodeTypeName(node->getNodeType()) << "\"";
+    if (auto number = nodeCast<NumberNode>(node)) {
+        os << ",\"value\":" << number->getValue();
+    } else if (auto boolean = nodeCast<BooleanLiteralNode>(node)) {
+        os << ",\"value\":" << (boolean->getValue() ? "true" : "false");
+    } else if (auto identifier = nodeCast<IdentifierNode>(node)) {
+        os << ",\"name\":\"" << identifier->getName() << "\"";
+    } else if (auto function = nodeCast<FunctionNode>(node)) {
+        os << ",\"name\":\"" << function->getName() << "\",\"params\":" << function->getParams().size();
+    } else if (node->getNodeType() == ASTNodeType::BinaryExpression) {
+        os << ",\"operator\":\"" << tokenTypeName(node->getTokenType()) << "\"";
+    }
+}
+
+void ASTPrinter::writeJson(ASTNodePtr root) {
+    // Open nodes with the children still to be written, nodes are
+    // numbered in preorder
+    struct Frame {
+        std::vector<ASTNodePtr> children;
+        size_t next;
+    };
+    std::vector<Frame> open;
+    uint32_t nextId = 0;
+
+    auto enter = [&](ASTNodePtr node) {
+        writeJsonFields(node, nextId++);
+        collectChildren(node);
+        if (children.empty()) {
+            os << "}";
+        } else {
+            os << ",\"children\":[";
+            open.push_back(Frame{children, 0});
+        }
+    };
+
+    enter(root);
+    while (!open.empty()) {
+        Frame& frame = open.back();
+        if (frame.next == frame.children.size()) {
+            os << "]}";
+            open.pop_back();
+            continue;
+        }
+        if (frame.next > 0) {
+            os << ",";
+        }
+        enter(frame.children[frame.next++]);
+    }
+    os << "\n";
+}
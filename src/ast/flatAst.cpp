@@ -0,0 +1,96 @@
+#include "flatAst.h"
+#include <utility>
+
+FlatNodeId FlatAST::addNode(FlatNodeId parent, ASTNodeType kind, TokenType token, int32_t payload) {
+    FlatNodeId node = static_cast<FlatNodeId>(kinds.size());
+    kinds.push_back(kind);
+    tokens.push_back(static_cast<uint8_t>(token));
+    firstChildren.push_back(NoFlatNode);
+    nextSiblings.push_back(NoFlatNode);
+    payloads.push_back(payload);
+    bindings.emplace_back();
+    types.push_back(DataType::Unknown);
+    lastChildren.push_back(NoFlatNode);
+
+    if (parent != NoFlatNode) {
+        if (lastChildren[parent] == NoFlatNode) {
+            firstChildren[parent] = node;
+        } else {
+            nextSiblings[lastChildren[parent]] = node;
+        }
+        lastChildren[parent] = node;
+    }
+    return node;
+}
+
+FlatNodeId FlatAST::addFunction(FlatNodeId parent, SymbolId name, uint32_t paramCount) {
+    functions.push_back(FlatFunction{name, paramCount});
+    return addNode(parent, ASTNodeType::FunctionDeclaration, TokenType::Keyword, static_cast<int32_t>(functions.size() - 1));
+}
+
+FlatAST FlatAST::build(ASTNodePtr root) {
+    FlatAST ast;
+    // Children are pushed in reverse so they come off the stack in order,
+    // an explicit stack keeps long operator chains off the C++ stack
+    std::vector<std::pair<ASTNodePtr, FlatNodeId>> pending{{root, NoFlatNode}};
+    auto push = [&](ASTNodeList children, FlatNodeId parent) {
+        for (size_t i = children.size(); i-- > 0;) {
+            pending.emplace_back(children[i], parent);
+        }
+    };
+
+    while (!pending.empty()) {
+        ASTNodePtr node = pending.back().first;
+        FlatNodeId parent = pending.back().second;
+        pending.pop_back();
+        FlatNodeId added = static_cast<FlatNodeId>(ast.size());
+
+        switch (node->getNodeType()) {
+            case ASTNodeType::Module: {
+                FlatNodeId id = ast.addNode(parent, ASTNodeType::Module, node->getTokenType(), 0);
+                push(static_cast<ModuleNode*>(node)->getItems(), id);
+                break;
+            }
+            case ASTNodeType::FunctionDeclaration: {
+                auto function = static_cast<FunctionNode*>(node);
+                FlatNodeId id = ast.addFunction(parent, function->getSymbol(), function->getParams().size());
+                push(function->getBodyNodes(), id);
+                push(function->getParams(), id);
+                break;
+            }
+            case ASTNodeType::VariableDeclaration: {
+                auto let = static_cast<LetNode*>(node);
+                FlatNodeId id = ast.addNode(parent, ASTNodeType::VariableDeclaration, node->getTokenType(), 0);
+                pending.emplace_back(let->getValue(), id);
+                pending.emplace_back(let->getIdentifier(), id);
+                break;
+            }
+            case ASTNodeType::BinaryExpression: {
+                FlatNodeId id = ast.addNode(parent, ASTNodeType::BinaryExpression, node->getTokenType(), 0);
+                if (node->getTokenType() == TokenType::Equals) {
+                    pending.emplace_back(static_cast<EqualsNode*>(node)->getRight(), id);
+                    pending.emplace_back(static_cast<EqualsNode*>(node)->getLeft(), id);
+                } else {
+                    pending.emplace_back(static_cast<BinaryOperatorNode*>(node)->getRight(), id);
+                    pending.emplace_back(static_cast<BinaryOperatorNode*>(node)->getLeft(), id);
+                }
+                break;
+            }
+            case ASTNodeType::Identifier: {
+                auto identifier = static_cast<IdentifierNode*>(node);
+                FlatNodeId id = ast.addNode(parent, ASTNodeType::Identifier, node->getTokenType(),
+                                            static_cast<int32_t>(identifier->getSymbol()));
+                ast.bind(id, identifier->getBinding());
+                break;
+            }
+            case ASTNodeType::Number:
+                ast.addNode(parent, ASTNodeType::Number, node->getTokenType(), static_cast<NumberNode*>(node)->getValue());
+                break;
+            case ASTNodeType::Boolean:
+                ast.addNode(parent, ASTNodeType::Boolean, node->getTokenType(), static_cast<BooleanLiteralNode*>(node)->getValue());
+                break;
+        }
+        ast.setType(added, node->getDataType());
+    }
+    return ast;
+}
@@ -0,0 +1,91 @@
+#include "moduleCompiler.h"
+#include <sstream>
+
+void ModuleCompiler::compile(ModuleNode& module, std::ostream& errors) {
+    units.clear();
+    code = CodeGenerator();
+    stats = PassStatistics();
+
+    ASTNodeList items = module.getItems();
+    for (size_t i = 0; i < items.size(); i++) {
+        bool isFunction = items[i]->getNodeType() == ASTNodeType::FunctionDeclaration;
+        if (isFunction || units.empty() || units.back().function) {
+            units.emplace_back();
+            units.back().begin = i;
+        }
+        units.back().end = i + 1;
+        if (isFunction) {
+            units.back().function = static_cast<FunctionNode*>(items[i]);
+        }
+    }
+
+    // The global scope has to be built in order, a function sees the
+    // globals declared before it. Stops at the first error, nothing after
+    // it gets compiled.
+    SemanticAnalyzer globals;
+    size_t count = units.size();
+    for (size_t u = 0; u < count; u++) {
+        Unit& unit = units[u];
+        if (unit.function) {
+            unit.visibleGlobals = globals.getGlobalCount();
+            continue;
+        }
+        std::ostringstream diagnostics;
+        globals.setErrorStream(diagnostics);
+        try {
+            for (size_t i = unit.begin; i < unit.end; i++) {
+                globals.analyze(items[i]);
+            }
+        } catch (...) {
+            unit.error = std::current_exception();
+            count = u + 1;
+        }
+        unit.diagnostics = diagnostics.str();
+    }
+
+    // Every unit numbers the globals by slot and keeps them in memory, so
+    // a global written by one unit is read from the same place by the next
+    uint32_t globalCount = globals.getGlobalCount();
+    pool.parallelFor(count, [&](size_t index, unsigned) {
+        Unit& unit = units[index];
+        if (unit.error) return;
+        unit.ir = IRGenerator(globalCount);
+        unit.code = CodeGenerator(globalCount);
+        std::ostringstream diagnostics;
+        try {
+            if (unit.function) {
+                SemanticAnalyzer analyzer(globals, unit.visibleGlobals, diagnostics);
+                analyzer.analyze(unit.function);
+            }
+            for (size_t i = unit.begin; i < unit.end; i++) {
+                unit.ir.generateIR(items[i]);
+            }
+            for (auto& function : unit.ir.getFunctions()) {
+                passes.run(function, unit.ir.getTempCounter(), unit.stats);
+                unit.code.generateCode(function);
+            }
+        } catch (...) {
+            unit.error = std::current_exception();
+        }
+        if (unit.function) {
+            unit.diagnostics = diagnostics.str();
+        }
+    });
+
+    for (size_t u = 0; u < count; u++) {
+        errors << units[u].diagnostics;
+        if (units[u].error) {
+            units.resize(u + 1);
+            std::rethrow_exception(units[u].error);
+        }
+        code.append(units[u].code);
+        stats += units[u].stats;
+    }
+    units.resize(count);
+}
+
+void ModuleCompiler::printIR() const {
+    for (const auto& unit : units) {
+        unit.ir.printIR();
+    }
+}
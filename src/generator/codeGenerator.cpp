@@ -5,8 +5,9 @@
 #include <iomanip>
 
 
-void CodeGenerator::generateCode(const std::vector<IRInstruction>& instructions) {
-    for (const auto& instruction : instructions) {
+void CodeGenerator::generateCode(const IRInstruction* instructions, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const IRInstruction& instruction = instructions[i];
         switch(instruction.type) {
             case IRInstructionType::ADD:
                 handleAdd(instruction);
@@ -32,6 +33,15 @@ void CodeGenerator::generateCode(const std::vector<IRInstruction>& instructions)
             case IRInstructionType::RET:
                 handleRet(instruction);
                 break;
+            case IRInstructionType::ZEXT:
+                handleZext(instruction);
+                break;
+            case IRInstructionType::JMP:
+            case IRInstructionType::BR:
+                // Nothing in the language branches yet
+                throw std::runtime_error("Branches are not supported by the code generator");
+            case IRInstructionType::PHI:
+                throw std::runtime_error("Phi nodes have to be removed before code generation");
         }
     }
 }
@@ -68,18 +78,13 @@ void CodeGenerator::disassembleCode() const {
 
 
 void CodeGenerator::handleAdd(const IRInstruction& instruction) {
-    uint8_t regDest = allocateRegister(instruction.dest);
+    uint8_t regDest = allocateRegister(instruction.dest());
 
-    if (instruction.src2.empty()) {
-        if (isInteger(instruction.src1)) {
-            int32_t imm = std::stoi(instruction.src1);
-            encodeImmediate(0x81, 0xC0 | regDest, imm);
-        } else {
-            throw std::runtime_error("Invalid immediate value for addition: " + instruction.src1);
-        }
+    if (instruction.src2().isImmediate()) {
+        encodeArithmeticImmediate(0, regDest, allocateRegister(instruction.src1()), instruction.src2().getImmediate());
     } else {
-        uint8_t regSrc1 = allocateRegister(instruction.src1);
-        uint8_t regSrc2 = allocateRegister(instruction.src2);
+        uint8_t regSrc1 = allocateRegister(instruction.src1());
+        uint8_t regSrc2 = allocateRegister(instruction.src2());
         encodeInstruction(0x01, regSrc1, regSrc2);
         if (regDest != regSrc1) {
             encodeInstruction(0x89, regDest, regSrc1);
@@ -88,18 +93,13 @@ void CodeGenerator::handleAdd(const IRInstruction& instruction) {
 }
 
 void CodeGenerator::handleSub(const IRInstruction& instruction) {
-    uint8_t regDest = allocateRegister(instruction.dest);
+    uint8_t regDest = allocateRegister(instruction.dest());
 
-    if (instruction.src2.empty()) {
-        if (isInteger(instruction.src1)) {
-            int32_t imm = std::stoi(instruction.src1);
-            encodeImmediate(0x81, 0xE8 | regDest, imm);
-        } else {
-            throw std::runtime_error("Invalid immediate value for subtraction: " + instruction.src1);
-        }
+    if (instruction.src2().isImmediate()) {
+        encodeArithmeticImmediate(5, regDest, allocateRegister(instruction.src1()), instruction.src2().getImmediate());
     } else {
-        uint8_t regSrc1 = allocateRegister(instruction.src1);
-        uint8_t regSrc2 = allocateRegister(instruction.src2);
+        uint8_t regSrc1 = allocateRegister(instruction.src1());
+        uint8_t regSrc2 = allocateRegister(instruction.src2());
         encodeInstruction(0x29, regSrc1, regSrc2);
         if (regDest != regSrc1) {
             encodeInstruction(0x89, regDest, regSrc1);
@@ -108,18 +108,21 @@ void CodeGenerator::handleSub(const IRInstruction& instruction) {
 }
 
 void CodeGenerator::handleMul(const IRInstruction& instruction) {
-    uint8_t regDest = allocateRegister(instruction.dest);
-
-    if (instruction.src2.empty()) {
-        if (isInteger(instruction.src1)) {
-            int32_t imm = std::stoi(instruction.src1);
-            encodeImmediate(0x6B, regDest, imm);
+    uint8_t regDest = allocateRegister(instruction.dest());
+
+    if (instruction.src2().isImmediate()) {
+        // IMUL r32, r/m32, imm has a separate destination
+        uint8_t regSrc = allocateRegister(instruction.src1());
+        int32_t imm = instruction.src2().getImmediate();
+        if (fitsInByte(imm)) {
+            encodeInstruction(0x6B, regDest, regSrc);
+            encodeInstruction(static_cast<uint8_t>(imm));
         } else {
-            throw std::runtime_error("Invalid immediate value for multiplication: " + instruction.src1);
+            encodeImmediate(0x69, 0xC0 | (regDest << 3) | regSrc, imm);
         }
     } else {
-        uint8_t regSrc1 = allocateRegister(instruction.src1);
-        uint8_t regSrc2 = allocateRegister(instruction.src2);
+        uint8_t regSrc1 = allocateRegister(instruction.src1());
+        uint8_t regSrc2 = allocateRegister(instruction.src2());
         encodeInstruction(0x0F, 0xAF, regSrc1, regSrc2);
         if (regDest != regSrc1) {
             encodeInstruction(0x89, regDest, regSrc1);
@@ -128,13 +131,13 @@ void CodeGenerator::handleMul(const IRInstruction& instruction) {
 }
 
 void CodeGenerator::handleDiv(const IRInstruction& instruction) {
-    uint8_t regDest = allocateRegister(instruction.dest);
+    uint8_t regDest = allocateRegister(instruction.dest());
     
-    if (instruction.src2.empty()) {
+    if (instruction.src2().isImmediate()) {
         throw std::runtime_error("Division by immediate value is not supported");
     } else {
-        uint8_t regSrc1 = allocateRegister(instruction.src1);
-        uint8_t regSrc2 = allocateRegister(instruction.src2);
+        uint8_t regSrc1 = allocateRegister(instruction.src1());
+        uint8_t regSrc2 = allocateRegister(instruction.src2());
 
         // Move the dividend into EAX (required by IDIV)
         if (regSrc1 != 0x00) {
@@ -155,20 +158,62 @@ void CodeGenerator::handleDiv(const IRInstruction& instruction) {
 }
 
 void CodeGenerator::handleLoad(const IRInstruction& instruction) {
-    uint8_t regDest = allocateRegister(instruction.dest);
-    if (isInteger(instruction.src1)) {
-        int32_t imm = std::stoi(instruction.src1);
-        encodeImmediate(0xB8 + regDest, 0xC0 | regDest, imm);
+    uint8_t regDest = allocateRegister(instruction.dest());
+    bool byte = instruction.valueType == IRType::I8;
+    if (isGlobal(instruction.src1())) {
+        encodeAbsolute(0x8B, regDest, globalAddress(instruction.src1())); // MOV r32, [address]
+    } else if (instruction.src1().isImmediate()) {
+        int32_t imm = instruction.src1().getImmediate();
+        if (byte && hasByteRegister(regDest)) {
+            encodeInstruction(0xB0 + regDest); // MOV r8, imm8
+            encodeInstruction(static_cast<uint8_t>(imm));
+        } else {
+            encodeImmediate(0xB8 + regDest, 0xC0 | regDest, imm);
+        }
     } else {
-        uint8_t regSrc = allocateRegister(instruction.src1);
-        encodeInstruction(0x8B, regDest, regSrc);
+        uint8_t regSrc = allocateRegister(instruction.src1());
+        bool byteMove = byte && hasByteRegister(regDest) && hasByteRegister(regSrc);
+        encodeInstruction(byteMove ? 0x8A : 0x8B, regDest, regSrc);
     }
 }
 
 void CodeGenerator::handleStore(const IRInstruction& instruction) {
-    uint8_t regSrc = allocateRegister(instruction.src1);
-    uint8_t regDest = allocateRegister(instruction.dest);
-    encodeInstruction(0x89, regSrc, regDest);
+    if (isGlobal(instruction.dest())) {
+        uint32_t address = globalAddress(instruction.dest());
+        if (instruction.src1().isImmediate()) {
+            encodeAbsolute(0xC7, 0, address); // MOV [address], imm32
+            int32_t imm = instruction.src1().getImmediate();
+            for (int i = 0; i < 4; ++i) {
+                generatedCode.push_back((imm >> (i * 8)) & 0xFF);
+            }
+        } else {
+            encodeAbsolute(0x89, allocateRegister(instruction.src1()), address); // MOV [address], r32
+        }
+        return;
+    }
+    // Constant propagation leaves immediates to store
+    if (instruction.src1().isImmediate()) {
+        handleLoad(instruction);
+        return;
+    }
+    uint8_t regSrc = allocateRegister(instruction.src1());
+    uint8_t regDest = allocateRegister(instruction.dest());
+    bool byteMove = instruction.valueType == IRType::I8 && hasByteRegister(regSrc) && hasByteRegister(regDest);
+    encodeInstruction(byteMove ? 0x88 : 0x89, regSrc, regDest);
+}
+
+void CodeGenerator::handleZext(const IRInstruction& instruction) {
+    uint8_t regSrc = allocateRegister(instruction.src1());
+    uint8_t regDest = allocateRegister(instruction.dest());
+    if (hasByteRegister(regSrc)) {
+        encodeInstruction(0x0F, 0xB6, regDest, regSrc); // MOVZX r32, r8
+    } else {
+        // No byte form of ESP..EDI, mask the full register instead
+        if (regDest != regSrc) {
+            encodeInstruction(0x8B, regDest, regSrc);
+        }
+        encodeImmediate(0x81, 0xE0 | regDest, 0xFF); // AND r32, 0xFF
+    }
 }
 
 void CodeGenerator::handleAlloc(const IRInstruction& instruction) {
@@ -219,6 +264,31 @@ void CodeGenerator::encodeImmediate(uint8_t opcode, uint8_t modrm, int32_t imm)
     }
 }
 
+// ModR/M with mod 00 and r/m 101 takes a 32-bit absolute address
+void CodeGenerator::encodeAbsolute(uint8_t opcode, uint8_t reg, uint32_t address) {
+    generatedCode.push_back(opcode);
+    generatedCode.push_back(0x05 | (reg << 3));
+    for (int i = 0; i < 4; ++i) {
+        generatedCode.push_back((address >> (i * 8)) & 0xFF);
+    }
+}
+
+// Group 1 ALU operation (0 ADD, 5 SUB, ...) of reg with an immediate into
+// dest, with the sign-extended byte form 0x83 when the value fits
+void CodeGenerator::encodeArithmeticImmediate(uint8_t extension, uint8_t dest, uint8_t reg, int32_t imm) {
+    if (dest != reg) {
+        encodeInstruction(0x8B, dest, reg); // MOV dest, reg
+    }
+    uint8_t modrm = 0xC0 | (extension << 3) | dest;
+    if (fitsInByte(imm)) {
+        encodeInstruction(0x83);
+        encodeInstruction(modrm);
+        encodeInstruction(static_cast<uint8_t>(imm));
+    } else {
+        encodeImmediate(0x81, modrm, imm);
+    }
+}
+
 // Starting simple with 8 general purpose registers
 uint8_t CodeGenerator::getRegisterCode(const std::string& reg) {
     if (reg == "EAX") return 0x00;
@@ -232,46 +302,52 @@ uint8_t CodeGenerator::getRegisterCode(const std::string& reg) {
     throw std::runtime_error("Unkown register: " + reg);
 }
 
-uint8_t CodeGenerator::allocateRegister(const std::string& var) {
-    if (registerMap.find(var) == registerMap.end()) {
-        if (nextRegister > 7) {
-            spillRegister();
-        }
-        registerMap[var] = nextRegister++;
+uint8_t& CodeGenerator::registerSlot(const IROperand& var) {
+    std::vector<uint8_t>* table;
+    switch (var.kind) {
+        case IROperandKind::Temp:
+            table = &tempRegisters;
+            break;
+        case IROperandKind::Variable:
+            if (isGlobal(var)) {
+                throw std::runtime_error("Globals live in memory, not in a register");
+            }
+            table = &variableRegisters;
+            break;
+        default:
+            throw std::runtime_error("Operand does not live in a register");
+    }
+    if (var.value >= table->size()) {
+        table->resize(var.value + 1, NoRegister);
     }
-    return registerMap[var];
+    return (*table)[var.value];
 }
 
-void CodeGenerator::spillRegister() {
-    // Find the least recently used register
-    std::string lruVar;
-    for (const auto& entry : registerMap) {
-        if (lruVar.empty() || lruVar > entry.first) {
-            lruVar = entry.first;
-        }
+uint8_t CodeGenerator::allocateRegister(const IROperand& var) {
+    uint8_t reg = registerSlot(var);
+    if (reg == NoRegister) {
+        reg = nextRegister > 7 ? spillRegister() : nextRegister++;
+        registerSlot(var) = reg;
+        registerOwner[reg] = var;
     }
+    return reg;
+}
 
-    if (!lruVar.empty()) {
-        uint8_t reg = registerMap[lruVar];
-        encodeInstruction(0x50 + reg); // PUSH reg
-        registerMap.erase(lruVar);
-        nextRegister--;
-    } else {
-        throw std::runtime_error("Unable to spill register: no registers available");
-    }
+// Registers are handed out in order, so evicting them round-robin spills
+// the value that has been resident the longest
+uint8_t CodeGenerator::spillRegister() {
+    uint8_t reg = nextSpill;
+    nextSpill = (nextSpill + 1) % 8;
+
+    encodeInstruction(0x50 + reg); // PUSH reg
+    registerSlot(registerOwner[reg]) = NoRegister;
+    return reg;
 }
 
-void CodeGenerator::reloadRegister(const std::string& var) {
-    if (registerMap.find(var) == registerMap.end()) {
-        throw std::runtime_error("Attempting to reload a register that was not spilled: " + var);
+void CodeGenerator::reloadRegister(const IROperand& var) {
+    uint8_t reg = registerSlot(var);
+    if (reg == NoRegister) {
+        throw std::runtime_error("Attempting to reload a register that was not spilled");
     }
-    uint8_t reg = registerMap[var];
     encodeInstruction(0x58 + reg); // POP reg
 }
-
-bool CodeGenerator::isInteger(const std::string& s) {
-    if (s.empty() || ((!isdigit(s[0])) && (s[0] != '-') && (s[0] != '+'))) return false;
-    char* p;
-    strtol(s.c_str(), &p, 10);
-    return (*p == 0);
-}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "dominatorTree.h"
+#include <algorithm>
+#include <utility>
+
+DominatorTree::DominatorTree(const IRFunction& function)
+    : idoms(function.getBlockCount(), NoBlock), children(function.getBlockCount()),
+      rpoIndex(function.getBlockCount(), NoIndex), treeBegin(function.getBlockCount(), 0),
+      treeEnd(function.getBlockCount(), 0) {
+    size_t count = function.getBlockCount();
+    if (count == 0) return;
+
+    // Postorder with an explicit stack of (block, next successor)
+    std::vector<bool> visited(count, false);
+    std::vector<std::pair<BlockId, size_t>> stack{{function.entry(), 0}};
+    visited[function.entry()] = true;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        const std::vector<BlockId>& successors = function.getBlock(block).successors;
+        if (next < successors.size()) {
+            BlockId successor = successors[next++];
+            if (!visited[successor]) {
+                visited[successor] = true;
+                stack.emplace_back(successor, 0);
+            }
+            continue;
+        }
+        reversePostorder.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(reversePostorder.begin(), reversePostorder.end());
+    for (uint32_t i = 0; i < reversePostorder.size(); i++) {
+        rpoIndex[reversePostorder[i]] = i;
+    }
+
+    // Walk both fingers up the tree built so far until they meet, blocks
+    // earlier in reverse postorder are higher up
+    auto intersect = [&](BlockId a, BlockId b) {
+        while (a != b) {
+            while (rpoIndex[a] > rpoIndex[b]) a = idoms[a];
+            while (rpoIndex[b] > rpoIndex[a]) b = idoms[b];
+        }
+        return a;
+    };
+
+    BlockId entry = function.entry();
+    idoms[entry] = entry;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < reversePostorder.size(); i++) {
+            BlockId block = reversePostorder[i];
+            BlockId idom = NoBlock;
+            for (BlockId predecessor : function.getBlock(block).predecessors) {
+                if (idoms[predecessor] == NoBlock) continue;
+                idom = idom == NoBlock ? predecessor : intersect(predecessor, idom);
+            }
+            if (idoms[block] != idom) {
+                idoms[block] = idom;
+                changed = true;
+            }
+        }
+    }
+    idoms[entry] = NoBlock;
+
+    for (BlockId block : reversePostorder) {
+        if (idoms[block] != NoBlock) {
+            children[idoms[block]].push_back(block);
+        }
+    }
+
+    // Number the tree so a dominates b iff b's number is within a's subtree
+    uint32_t number = 0;
+    std::vector<std::pair<BlockId, size_t>> walk{{entry, 0}};
+    treeBegin[entry] = number++;
+    while (!walk.empty()) {
+        auto& [block, next] = walk.back();
+        if (next < children[block].size()) {
+            BlockId child = children[block][next++];
+            treeBegin[child] = number++;
+            walk.emplace_back(child, 0);
+            continue;
+        }
+        treeEnd[block] = number;
+        walk.pop_back();
+    }
+}
+
+bool DominatorTree::dominates(BlockId a, BlockId b) const {
+    if (!isReachable(a) || !isReachable(b)) {
+        return false;
+    }
+    return treeBegin[a] <= treeBegin[b] && treeBegin[b] < treeEnd[a];
+}
@@ -0,0 +1,328 @@
+#include "irFile.h"
+#include "stringInterner.h"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<IRInstruction>::value && offsetof(IRInstruction, operands) == 4,
+              "Instruction records are written and read as they are laid out in memory");
+
+namespace {
+
+constexpr uint32_t ByteOrder = 0x01020304;
+
+uint32_t align(size_t offset) {
+    return static_cast<uint32_t>((offset + 7) & ~size_t(7));
+}
+
+uint32_t count(size_t size) {
+    return static_cast<uint32_t>(size);
+}
+
+} // namespace
+
+uint32_t IRFileWriter::string(SymbolId symbol) {
+    if (symbol == InvalidSymbol) return NoString;
+    if (symbol >= symbolStrings.size()) {
+        symbolStrings.resize(symbol + 1, NoString);
+    }
+    if (symbolStrings[symbol] == NoString) {
+        std::string_view text = StringInterner::global().lookup(symbol);
+        symbolStrings[symbol] = count(strings.size());
+        strings.push_back(IRFileString{count(stringData.size()), count(text.size())});
+        stringData.append(text.data(), text.size());
+    }
+    return symbolStrings[symbol];
+}
+
+void IRFileWriter::addUnit(const IRGenerator& generator) {
+    IRFileUnit unit;
+    unit.firstFunction = count(functions.size());
+    unit.functionCount = count(generator.getFunctions().size());
+    unit.firstVariable = count(variables.size());
+    unit.variableCount = generator.getVariableCount();
+    unit.globalCount = generator.getGlobalCount();
+    unit.tempCount = generator.getTempCount();
+    units.push_back(unit);
+    for (uint32_t v = 0; v < unit.variableCount; v++) {
+        variables.push_back(string(generator.getVariableName(v)));
+    }
+
+    for (const auto& function : generator.getFunctions()) {
+        IRFileFunction record;
+        record.name = string(function.getName());
+        record.firstBlock = count(blocks.size());
+        record.blockCount = count(function.getBlockCount());
+        record.firstInstruction = count(instructions.size());
+        record.instructionCount = count(function.getInstructions().size());
+        record.firstPhiOperand = count(phiOperands.size());
+        record.firstLocal = count(locals.size());
+        record.localCount = count(function.getLocalVariables().size());
+
+        instructions.insert(instructions.end(), function.getInstructions().begin(), function.getInstructions().end());
+        // Phis refer to their operands by offset, which stays valid
+        for (const auto& operand : function.getPhiOperands()) {
+            phiOperands.push_back(IRFileOperand{static_cast<uint32_t>(operand.kind), operand.value});
+        }
+        record.phiOperandCount = count(function.getPhiOperands().size());
+
+        for (const auto& block : function.getBlocks()) {
+            IRFileBlock blockRecord;
+            blockRecord.begin = block.begin;
+            blockRecord.end = block.end;
+            blockRecord.firstEdge = count(edges.size());
+            blockRecord.successorCount = count(block.successors.size());
+            blockRecord.predecessorCount = count(block.predecessors.size());
+            edges.insert(edges.end(), block.successors.begin(), block.successors.end());
+            edges.insert(edges.end(), block.predecessors.begin(), block.predecessors.end());
+            blocks.push_back(blockRecord);
+        }
+        locals.insert(locals.end(), function.getLocalVariables().begin(), function.getLocalVariables().end());
+        functions.push_back(record);
+    }
+}
+
+void IRFileWriter::write(const std::string& filename) const {
+    IRFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "BMIR", 4);
+    header.version = IRFileVersion;
+    header.byteOrder = ByteOrder;
+    header.instructionSize = sizeof(IRInstruction);
+
+    // Sections in order, each aligned
+    size_t offset = sizeof(IRFileHeader);
+    auto place = [&](uint32_t& countField, uint32_t& offsetField, size_t elements, size_t size) {
+        offset = align(offset);
+        countField = count(elements);
+        offsetField = count(offset);
+        offset += elements * size;
+    };
+    place(header.unitCount, header.unitOffset, units.size(), sizeof(IRFileUnit));
+    place(header.functionCount, header.functionOffset, functions.size(), sizeof(IRFileFunction));
+    place(header.blockCount, header.blockOffset, blocks.size(), sizeof(IRFileBlock));
+    place(header.edgeCount, header.edgeOffset, edges.size(), sizeof(uint32_t));
+    place(header.instructionCount, header.instructionOffset, instructions.size(), sizeof(IRInstruction));
+    place(header.phiOperandCount, header.phiOperandOffset, phiOperands.size(), sizeof(IRFileOperand));
+    place(header.localCount, header.localOffset, locals.size(), sizeof(uint32_t));
+    place(header.variableCount, header.variableOffset, variables.size(), sizeof(uint32_t));
+    place(header.stringCount, header.stringOffset, strings.size(), sizeof(IRFileString));
+    place(header.stringBytes, header.stringDataOffset, stringData.size(), 1);
+    if (offset > UINT32_MAX) {
+        throw std::runtime_error("IR does not fit in an IR file");
+    }
+    header.fileSize = count(offset);
+
+    std::vector<char> image(offset, 0);
+    auto copy = [&](uint32_t at, const void* data, size_t bytes) {
+        if (bytes) std::memcpy(image.data() + at, data, bytes);
+    };
+    copy(0, &header, sizeof(header));
+    copy(header.unitOffset, units.data(), units.size() * sizeof(IRFileUnit));
+    copy(header.functionOffset, functions.data(), functions.size() * sizeof(IRFileFunction));
+    copy(header.blockOffset, blocks.data(), blocks.size() * sizeof(IRFileBlock));
+    copy(header.edgeOffset, edges.data(), edges.size() * sizeof(uint32_t));
+    copy(header.instructionOffset, instructions.data(), instructions.size() * sizeof(IRInstruction));
+    copy(header.phiOperandOffset, phiOperands.data(), phiOperands.size() * sizeof(IRFileOperand));
+    copy(header.localOffset, locals.data(), locals.size() * sizeof(uint32_t));
+    copy(header.variableOffset, variables.data(), variables.size() * sizeof(uint32_t));
+    copy(header.stringOffset, strings.data(), strings.size() * sizeof(IRFileString));
+    copy(header.stringDataOffset, stringData.data(), stringData.size());
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(image.data(), image.size());
+    if (!file) {
+        throw std::runtime_error("Could not write IR file " + filename);
+    }
+}
+
+IRFile::IRFile(const std::string& filename) : buffer(new SourceBuffer(filename)) {
+    std::string_view bytes = buffer->view();
+    base = bytes.data();
+    header = reinterpret_cast<const IRFileHeader*>(base);
+    auto invalid = [&](const std::string& reason) {
+        return std::runtime_error(filename + " is not a usable IR file: " + reason);
+    };
+    if (bytes.size() < sizeof(IRFileHeader) || std::memcmp(header->magic, "BMIR", 4) != 0) {
+        throw invalid("no IR header");
+    }
+    if (header->version != IRFileVersion) {
+        throw invalid("version " + std::to_string(header->version) + ", expected " + std::to_string(IRFileVersion));
+    }
+    if (header->byteOrder != ByteOrder || header->instructionSize != sizeof(IRInstruction)) {
+        throw invalid("written for another machine");
+    }
+    if (header->fileSize != bytes.size()) {
+        throw invalid("truncated");
+    }
+
+    auto checkSection = [&](uint32_t elements, uint32_t offset, size_t size) {
+        if (offset % 8 != 0 || offset < sizeof(IRFileHeader) || offset > bytes.size()
+            || elements > (bytes.size() - offset) / size) {
+            throw invalid("section out of bounds");
+        }
+    };
+    checkSection(header->unitCount, header->unitOffset, sizeof(IRFileUnit));
+    checkSection(header->functionCount, header->functionOffset, sizeof(IRFileFunction));
+    checkSection(header->blockCount, header->blockOffset, sizeof(IRFileBlock));
+    checkSection(header->edgeCount, header->edgeOffset, sizeof(uint32_t));
+    checkSection(header->instructionCount, header->instructionOffset, sizeof(IRInstruction));
+    checkSection(header->phiOperandCount, header->phiOperandOffset, sizeof(IRFileOperand));
+    checkSection(header->localCount, header->localOffset, sizeof(uint32_t));
+    checkSection(header->variableCount, header->variableOffset, sizeof(uint32_t));
+    checkSection(header->stringCount, header->stringOffset, sizeof(IRFileString));
+    checkSection(header->stringBytes, header->stringDataOffset, 1);
+
+    // Ranges of the records that index into other sections
+    auto within = [](uint32_t first, uint32_t length, uint32_t total) {
+        return first <= total && length <= total - first;
+    };
+    auto isString = [&](uint32_t string) { return string == NoString || string < header->stringCount; };
+    const IRFileString* strings = section<IRFileString>(header->stringOffset);
+    for (uint32_t s = 0; s < header->stringCount; s++) {
+        if (!within(strings[s].offset, strings[s].length, header->stringBytes)) {
+            throw invalid("string out of bounds");
+        }
+    }
+    const uint32_t* variables = section<uint32_t>(header->variableOffset);
+    for (uint32_t v = 0; v < header->variableCount; v++) {
+        if (!isString(variables[v])) {
+            throw invalid("variable name out of bounds");
+        }
+    }
+
+    // Functions are checked through their unit, which numbers their
+    // temporaries and variables
+    for (uint32_t u = 0; u < header->unitCount; u++) {
+        const IRFileUnit& unit = getUnit(u);
+        if (!within(unit.firstFunction, unit.functionCount, header->functionCount)
+            || !within(unit.firstVariable, unit.variableCount, header->variableCount)
+            || unit.globalCount > unit.variableCount) {
+            throw invalid("unit out of bounds");
+        }
+        for (uint32_t f = 0; f < unit.functionCount; f++) {
+            const IRFileFunction& function = getFunction(unit, f);
+            if (!isString(function.name)
+                || !within(function.firstBlock, function.blockCount, header->blockCount)
+                || !within(function.firstInstruction, function.instructionCount, header->instructionCount)
+                || !within(function.firstPhiOperand, function.phiOperandCount, header->phiOperandCount)
+                || !within(function.firstLocal, function.localCount, header->localCount)) {
+                throw invalid("function out of bounds");
+            }
+            for (uint32_t b = 0; b < function.blockCount; b++) {
+                const IRFileBlock& block = getBlocks(function)[b];
+                if (block.begin > block.end || block.end > function.instructionCount
+                    || !within(block.firstEdge, block.successorCount, header->edgeCount)
+                    || !within(block.firstEdge + block.successorCount, block.predecessorCount, header->edgeCount)) {
+                    throw invalid("block out of bounds");
+                }
+                for (uint32_t e = 0; e < block.successorCount + block.predecessorCount; e++) {
+                    if (getEdges(block)[e] >= function.blockCount) {
+                        throw invalid("edge to a block that does not exist");
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < function.instructionCount; i++) {
+                if (!isValid(unit, function, getInstructions(function)[i])) {
+                    throw invalid("instruction " + std::to_string(i) + " of function " + std::to_string(f) + " of unit "
+                                  + std::to_string(u) + " is malformed");
+                }
+            }
+            for (uint32_t k = 0; k < function.phiOperandCount; k++) {
+                const IRFileOperand& operand = getPhiOperands(function)[k];
+                if (operand.kind > static_cast<uint32_t>(IROperandKind::Immediate)
+                    || (operand.kind == static_cast<uint32_t>(IROperandKind::Temp) && operand.value >= unit.tempCount)
+                    || (operand.kind == static_cast<uint32_t>(IROperandKind::Variable) && operand.value >= unit.variableCount)) {
+                    throw invalid("phi operand out of bounds");
+                }
+            }
+            for (uint32_t l = 0; l < function.localCount; l++) {
+                if (getLocalVariables(function)[l] >= unit.variableCount) {
+                    throw invalid("local variable out of bounds");
+                }
+            }
+        }
+    }
+}
+
+// Whether the code generator and loadFunction can take an instruction as
+// is: every operand names something that exists and has the kind its
+// position calls for
+bool IRFile::isValid(const IRFileUnit& unit, const IRFileFunction& function, const IRInstruction& instruction) const {
+    if (instruction.type > IRInstructionType::PHI || instruction.valueType > IRType::I32 || instruction.reserved != 0) {
+        return false;
+    }
+    auto isValue = [&](IROperand operand) {
+        switch (operand.kind) {
+            case IROperandKind::Temp:
+                return operand.value < unit.tempCount;
+            case IROperandKind::Variable:
+                return operand.value < unit.variableCount;
+            case IROperandKind::Immediate:
+                return true;
+            default:
+                return false;
+        }
+    };
+    auto isDestination = [&](IROperand operand) { return operand.kind != IROperandKind::Immediate && isValue(operand); };
+    auto isBlock = [&](IROperand operand) { return operand.isImmediate() && operand.value < function.blockCount; };
+    auto isNone = [](IROperand operand) { return operand.isNone() && operand.value == 0; };
+
+    IROperand dest = instruction.dest();
+    IROperand src1 = instruction.src1();
+    IROperand src2 = instruction.src2();
+    switch (instruction.type) {
+        case IRInstructionType::ADD:
+        case IRInstructionType::SUB:
+        case IRInstructionType::MUL:
+        case IRInstructionType::DIV:
+            return isDestination(dest) && isValue(src1) && isValue(src2);
+        case IRInstructionType::LOAD:
+        case IRInstructionType::STORE:
+        case IRInstructionType::ZEXT:
+            return isDestination(dest) && isValue(src1) && isNone(src2);
+        case IRInstructionType::ALLOC:
+        case IRInstructionType::RET:
+            return isNone(dest) && isNone(src1) && isNone(src2);
+        case IRInstructionType::JMP:
+            return isNone(dest) && isBlock(src1) && isNone(src2);
+        case IRInstructionType::BR:
+            return isBlock(dest) && isValue(src1) && isBlock(src2);
+        case IRInstructionType::PHI:
+            return isDestination(dest) && src1.isImmediate() && src2.isImmediate()
+                && src1.value <= function.phiOperandCount && src2.value <= function.phiOperandCount - src1.value;
+    }
+    return false;
+}
+
+std::string_view IRFile::getString(uint32_t string) const {
+    if (string == NoString) return std::string_view();
+    const IRFileString& record = section<IRFileString>(header->stringOffset)[string];
+    return std::string_view(base + header->stringDataOffset + record.offset, record.length);
+}
+
+IRFunction IRFile::loadFunction(const IRFileUnit& unit, size_t index) const {
+    const IRFileFunction& record = getFunction(unit, index);
+    IRFunction function(record.name == NoString ? InvalidSymbol : StringInterner::global().intern(getString(record.name)));
+    const IRInstruction* instructions = getInstructions(record);
+    for (uint32_t b = 0; b < record.blockCount; b++) {
+        const IRFileBlock& block = getBlocks(record)[b];
+        function.addBlock();
+        for (uint32_t i = block.begin; i < block.end; i++) {
+            function.append(instructions[i]);
+        }
+    }
+    // Edges before phi operands, so nothing needs remapping
+    function.buildCFG();
+
+    std::vector<IROperand> phiOperands(record.phiOperandCount);
+    for (uint32_t k = 0; k < record.phiOperandCount; k++) {
+        const IRFileOperand& operand = getPhiOperands(record)[k];
+        phiOperands[k] = IROperand{static_cast<IROperandKind>(operand.kind), operand.value};
+    }
+    function.setPhiOperands(std::move(phiOperands));
+    function.setLocalVariables(std::vector<uint32_t>(getLocalVariables(record), getLocalVariables(record) + record.localCount));
+    return function;
+}
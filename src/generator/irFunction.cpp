@@ -0,0 +1,183 @@
+#include "irFunction.h"
+#include <algorithm>
+#include <stdexcept>
+
+std::ostream& operator<<(std::ostream& os, const IROperand& operand) {
+    switch (operand.kind) {
+        case IROperandKind::None:
+            break;
+        case IROperandKind::Temp:
+            os << "t" << operand.value;
+            break;
+        case IROperandKind::Variable:
+            os << "v" << operand.value;
+            break;
+        case IROperandKind::Immediate:
+            os << operand.getImmediate();
+            break;
+    }
+    return os;
+}
+
+BlockId IRFunction::addBlock() {
+    blocks.emplace_back();
+    blocks.back().begin = blocks.back().end = static_cast<uint32_t>(instructions.size());
+    return static_cast<BlockId>(blocks.size() - 1);
+}
+
+void IRFunction::append(const IRInstruction& instruction) {
+    if (blocks.empty()) {
+        addBlock();
+    }
+    instructions.push_back(instruction);
+    blocks.back().end = static_cast<uint32_t>(instructions.size());
+}
+
+void IRFunction::jump(BlockId target) {
+    append(IRInstruction(IRInstructionType::JMP, IROperand(), IROperand::immediate(target), IROperand(), IRType::Void));
+}
+
+void IRFunction::branch(IROperand condition, BlockId ifTrue, BlockId ifFalse) {
+    append(IRInstruction(IRInstructionType::BR, IROperand::immediate(ifTrue), condition, IROperand::immediate(ifFalse),
+                         IRType::Void));
+}
+
+void IRFunction::replaceInstructions(std::vector<IRInstruction> rewritten, const std::vector<uint32_t>& blockEnds) {
+    instructions = std::move(rewritten);
+    uint32_t begin = 0;
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        blocks[b].begin = begin;
+        blocks[b].end = begin = blockEnds[b];
+    }
+}
+
+IRInstruction IRFunction::makePhi(IROperand dest, IRType valueType, uint32_t incomingCount) {
+    IRInstruction phi(IRInstructionType::PHI, dest, IROperand::immediate(static_cast<int32_t>(phiOperands.size())),
+                      IROperand::immediate(static_cast<int32_t>(incomingCount)), valueType);
+    phiOperands.resize(phiOperands.size() + incomingCount);
+    return phi;
+}
+
+void IRFunction::removeBlocks(const std::vector<bool>& removed) {
+    std::vector<BlockId> renumbered(blocks.size(), NoBlock);
+    BlockId count = 0;
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        if (!removed[b]) renumbered[b] = count++;
+    }
+    if (count == blocks.size()) return;
+
+    std::vector<IRInstruction> kept;
+    std::vector<BasicBlock> keptBlocks;
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        if (removed[b]) continue;
+        BasicBlock block;
+        block.begin = static_cast<uint32_t>(kept.size());
+        // Removed predecessors take their phi operands with them
+        std::vector<bool> keepIncoming;
+        for (BlockId predecessor : blocks[b].predecessors) {
+            keepIncoming.push_back(!removed[predecessor]);
+            if (!removed[predecessor]) block.predecessors.push_back(renumbered[predecessor]);
+        }
+        for (BlockId successor : blocks[b].successors) {
+            block.successors.push_back(renumbered[successor]);
+        }
+        for (uint32_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            IRInstruction instruction = instructions[i];
+            switch (instruction.type) {
+                case IRInstructionType::JMP:
+                    instruction.setOperand(1, IROperand::immediate(renumbered[instruction.src1().value]));
+                    break;
+                case IRInstructionType::BR:
+                    instruction.setOperand(0, IROperand::immediate(renumbered[instruction.dest().value]));
+                    instruction.setOperand(2, IROperand::immediate(renumbered[instruction.src2().value]));
+                    break;
+                case IRInstructionType::PHI: {
+                    uint32_t k = 0;
+                    IROperand* incoming = phiIncoming(instruction);
+                    for (size_t old = 0; old < keepIncoming.size(); old++) {
+                        if (keepIncoming[old]) incoming[k++] = incoming[old];
+                    }
+                    instruction.setOperand(2, IROperand::immediate(static_cast<int32_t>(k)));
+                    break;
+                }
+                default:
+                    break;
+            }
+            kept.push_back(instruction);
+        }
+        block.end = static_cast<uint32_t>(kept.size());
+        keptBlocks.push_back(std::move(block));
+    }
+    instructions = std::move(kept);
+    blocks = std::move(keptBlocks);
+}
+
+void IRFunction::buildCFG() {
+    // Phis are indexed by predecessor, keep the old lists to remap them
+    std::vector<std::vector<BlockId>> oldPredecessors;
+    if (!phiOperands.empty()) {
+        for (auto& block : blocks) {
+            oldPredecessors.push_back(block.predecessors);
+        }
+    }
+    for (auto& block : blocks) {
+        block.predecessors.clear();
+        block.successors.clear();
+    }
+
+    auto addEdge = [&](BlockId from, uint32_t to) {
+        if (to >= blocks.size()) {
+            throw std::runtime_error("Branch to a block that does not exist");
+        }
+        // Both sides of a branch may go to the same block, keep one edge
+        for (BlockId successor : blocks[from].successors) {
+            if (successor == to) return;
+        }
+        blocks[from].successors.push_back(to);
+        blocks[to].predecessors.push_back(from);
+    };
+
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        const BasicBlock& block = blocks[b];
+        bool last = b + 1 == blocks.size();
+        if (block.begin == block.end || !isTerminator(instructions[block.end - 1].type)) {
+            if (!last) {
+                throw std::runtime_error("Basic block does not end in a terminator");
+            }
+            continue;
+        }
+
+        const IRInstruction& terminator = instructions[block.end - 1];
+        switch (terminator.type) {
+            case IRInstructionType::JMP:
+                addEdge(b, terminator.src1().value);
+                break;
+            case IRInstructionType::BR:
+                addEdge(b, terminator.dest().value);
+                addEdge(b, terminator.src2().value);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (oldPredecessors.empty()) return;
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        const std::vector<BlockId>& predecessors = blocks[b].predecessors;
+        if (predecessors == oldPredecessors[b]) continue;
+        for (uint32_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            if (instructions[i].type != IRInstructionType::PHI) continue;
+            // New edges start out without a value
+            std::vector<IROperand> incoming(predecessors.size());
+            for (size_t k = 0; k < predecessors.size(); k++) {
+                for (size_t old = 0; old < oldPredecessors[b].size(); old++) {
+                    if (oldPredecessors[b][old] == predecessors[k]) {
+                        incoming[k] = phiIncoming(instructions[i])[old];
+                    }
+                }
+            }
+            instructions[i] = makePhi(instructions[i].dest(), instructions[i].valueType, static_cast<uint32_t>(incoming.size()));
+            std::copy(incoming.begin(), incoming.end(), phiIncoming(instructions[i]));
+        }
+    }
+}
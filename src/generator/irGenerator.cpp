@@ -1,100 +1,344 @@
 #include "irGenerator.h"
 
+IRGenerator::IRGenerator(uint32_t globalCount)
+    : tempVarCounter(0), globalCount(globalCount), globalVariables(globalCount), variableNames(globalCount, InvalidSymbol),
+      variableFunctions(globalCount, SharedVariable) {
+    for (uint32_t slot = 0; slot < globalCount; slot++) {
+        globalVariables[slot] = slot;
+    }
+}
+
 void IRGenerator::generateIR(ASTNodePtr root) {
-    root->accept(*this);
+    dispatch(*root);
+}
+
+void IRGenerator::printIR() const {
+    auto print = [&](const IROperand& operand) -> std::ostream& {
+        if (operand.kind == IROperandKind::Variable) {
+            return std::cout << StringInterner::global().lookup(variableNames[operand.value]);
+        }
+        return std::cout << operand;
+    };
+    for (const auto& function : functions) {
+        const std::vector<IRInstruction>& instructions = function.getInstructions();
+        for (BlockId b = 0; b < function.getBlockCount(); b++) {
+            // Straight-line functions are printed without labels
+            if (function.getBlockCount() > 1) {
+                std::cout << "Block " << b << ":" << std::endl;
+            }
+            for (uint32_t i = function.getBlock(b).begin; i < function.getBlock(b).end; i++) {
+                const IRInstruction& instr = instructions[i];
+                std::cout << "Instruction: " << static_cast<int>(instr.type) << " ";
+                print(instr.dest()) << " ";
+                print(instr.src1()) << " ";
+                print(instr.src2()) << std::endl;
+            }
+        }
+    }
+}
+
+// Resolved identifiers are numbered through their slot, no name lookups
+IROperand IRGenerator::variable(SymbolId name, const Binding& binding) {
+    uint32_t* index;
+    if (!binding.isResolved()) {
+        index = &unresolvedVariables.emplace(name, NoVariable).first->second;
+    } else {
+        std::vector<uint32_t>& slots = binding.global ? globalVariables : frameVariables;
+        if (binding.slot >= slots.size()) {
+            slots.resize(binding.slot + 1, NoVariable);
+        }
+        index = &slots[binding.slot];
+    }
+
+    if (*index == NoVariable) {
+        *index = static_cast<uint32_t>(variableNames.size());
+        variableNames.push_back(name);
+        variableFunctions.push_back(NoFunction);
+    } else if (variableNames[*index] == InvalidSymbol) {
+        // Reserved global, named once this generator sees it used
+        variableNames[*index] = name;
+    }
+
+    uint32_t& user = variableFunctions[*index];
+    if (!binding.isResolved() || binding.global || openFunctions.empty()) {
+        user = SharedVariable;
+    } else if (user == NoFunction) {
+        user = openFunctions.back();
+    } else if (user != openFunctions.back()) {
+        user = SharedVariable;
+    }
+    return IROperand::variable(*index);
+}
+
+void IRGenerator::generateInstruction(IRInstructionType type, IROperand dest, IROperand src1, IROperand src2,
+                                      IRType valueType) {
+    if (openFunctions.empty() && initializer == NoFunction) {
+        initializer = static_cast<uint32_t>(functions.size());
+        functions.emplace_back();
+    }
+    uint32_t function = openFunctions.empty() ? initializer : openFunctions.back();
+    functions[function].append(IRInstruction(type, dest, src1, src2, valueType));
+}
+
+// Nested functions get an IRFunction of their own but share the frame of
+// the outermost one
+void IRGenerator::beginFunction(SymbolId name) {
+    if (openFunctions.empty()) {
+        frameVariables.clear();
+        initializer = NoFunction;
+        groupBegin = static_cast<uint32_t>(functions.size());
+        groupVariables = static_cast<uint32_t>(variableNames.size());
+    }
+    openFunctions.push_back(static_cast<uint32_t>(functions.size()));
+    functions.emplace_back(name);
+    functions.back().addBlock();
 }
 
-void IRGenerator::generateInstruction(IRInstructionType type, const std::string& dest, const std::string& src1, const std::string& src2) {
-    irInstructions.emplace_back(type, dest, src1, src2);
+// Initializers are a single block and never need edges
+void IRGenerator::endFunction() {
+    generateInstruction(IRInstructionType::RET, IROperand(), IROperand(), IROperand(), IRType::Void);
+    functions[openFunctions.back()].buildCFG();
+    openFunctions.pop_back();
+
+    // Frame variables are numbered afresh for every top-level function, so
+    // once it is done nothing else can use them
+    if (openFunctions.empty()) {
+        std::vector<std::vector<uint32_t>> locals(functions.size() - groupBegin);
+        for (uint32_t v = groupVariables; v < variableFunctions.size(); v++) {
+            uint32_t user = variableFunctions[v];
+            if (user != NoFunction && user != SharedVariable && user >= groupBegin) {
+                locals[user - groupBegin].push_back(v);
+            }
+        }
+        for (size_t i = 0; i < locals.size(); i++) {
+            functions[groupBegin + i].setLocalVariables(std::move(locals[i]));
+        }
+    }
 }
 
-std::string IRGenerator::handleLiteral(ASTNodePtr node) {
-    if (auto numberNode = std::dynamic_pointer_cast<NumberNode>(node)) {
-        std::string tempVar = newTempVar();
-        generateInstruction(IRInstructionType::LOAD, tempVar, std::to_string(numberNode->getValue()), "");
+IROperand IRGenerator::handleLiteral(ASTNodePtr node) {
+    if (auto numberNode = nodeCast<NumberNode>(node)) {
+        IROperand tempVar = newTempVar();
+        generateInstruction(IRInstructionType::LOAD, tempVar, IROperand::immediate(numberNode->getValue()));
         return tempVar;
-    } else if (auto booleanNode = std::dynamic_pointer_cast<BooleanLiteralNode>(node)) {
-        std::string tempVar = newTempVar();
-        generateInstruction(IRInstructionType::LOAD, tempVar, booleanNode->getValue() ? "1" : "0", "");
+    } else if (auto booleanNode = nodeCast<BooleanLiteralNode>(node)) {
+        IROperand tempVar = newTempVar();
+        generateInstruction(IRInstructionType::LOAD, tempVar, IROperand::immediate(booleanNode->getValue() ? 1 : 0),
+                            IROperand(), IRType::I8);
         return tempVar;
-    } else if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
-        std::string tempVar = newTempVar();
-        generateInstruction(IRInstructionType::LOAD, tempVar, identifierNode->getName(), "");
+    } else if (auto identifierNode = nodeCast<IdentifierNode>(node)) {
+        IROperand tempVar = newTempVar();
+        generateInstruction(IRInstructionType::LOAD, tempVar, variable(identifierNode->getSymbol(), identifierNode->getBinding()),
+                            IROperand(), irType(identifierNode->getDataType()));
         return tempVar;
+    } else if (auto binaryOpNode = nodeCast<BinaryOperatorNode>(node)) {
+        visit(*binaryOpNode);
+        return IROperand::temp(binaryOpNode->getResultVar());
     }
-    return "";
+    return IROperand();
 }
 
-void IRGenerator::visit(BinaryOperatorNode& node) {
-    auto left = node.getLeft();
-    auto right = node.getRight();
-
-    if (left && right) {
-        std::string leftTemp = handleLiteral(left);
-        std::string rightTemp = handleLiteral(right);
-
-        std::string resultTemp = newTempVar();
-        IRInstructionType instrType;
-
-        // Determine the instruction type based on the operator
-        switch (node.getTokenType()) {
-            case TokenType::Add:
-                instrType = IRInstructionType::ADD;
-                break;
-            case TokenType::Subtract:
-                instrType = IRInstructionType::SUB;
-                break;
-            case TokenType::Multiply:
-                instrType = IRInstructionType::MUL;
-                break;
-            case TokenType::Divide:
-                instrType = IRInstructionType::DIV;
-                break;
-            default:
-                throw std::runtime_error("Unsupported binary operator");
+// Arithmetic works on 32 bits, bytes are widened right before use
+IROperand IRGenerator::widen(IROperand value, DataType type) {
+    if (irType(type) != IRType::I8) {
+        return value;
+    }
+    IROperand wide = newTempVar();
+    generateInstruction(IRInstructionType::ZEXT, wide, value);
+    return wide;
+}
+
+IROperand IRGenerator::arithmeticOperand(ASTNodePtr node) {
+    return widen(handleLiteral(node), node->getDataType());
+}
+
+// Literals on the right of ADD, SUB and MUL are used as immediates, a bool
+// needs no widening as one
+IROperand IRGenerator::rightOperand(ASTNodePtr node, IRInstructionType type) {
+    if (hasImmediateForm(type)) {
+        if (auto numberNode = nodeCast<NumberNode>(node)) {
+            return IROperand::immediate(numberNode->getValue());
+        } else if (auto booleanNode = nodeCast<BooleanLiteralNode>(node)) {
+            return IROperand::immediate(booleanNode->getValue() ? 1 : 0);
         }
+    }
+    return arithmeticOperand(node);
+}
 
-        generateInstruction(instrType, resultTemp, leftTemp, rightTemp);
+static IRInstructionType binaryInstructionType(TokenType op) {
+    switch (op) {
+        case TokenType::Add:
+            return IRInstructionType::ADD;
+        case TokenType::Subtract:
+            return IRInstructionType::SUB;
+        case TokenType::Multiply:
+            return IRInstructionType::MUL;
+        case TokenType::Divide:
+            return IRInstructionType::DIV;
+        default:
+            throw std::runtime_error("Unsupported binary operator");
+    }
+}
+
+void IRGenerator::visit(BinaryOperatorNode& node) {
+    // Operator chains are left-deep, walk down the left spine in a loop
+    // rather than recursing once per operator
+    std::vector<BinaryOperatorNode*> chain{&node};
+    while (auto left = nodeCast<BinaryOperatorNode>(chain.back()->getLeft())) {
+        chain.push_back(left);
+    }
+
+    IROperand leftTemp = arithmeticOperand(chain.back()->getLeft());
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        IRInstructionType type = binaryInstructionType((*it)->getTokenType());
+        IROperand rightTemp = rightOperand((*it)->getRight(), type);
+        IROperand resultTemp = newTempVar();
+        generateInstruction(type, resultTemp, leftTemp, rightTemp);
 
         // Store the result in the node
-        node.setResultVar(resultTemp);
+        (*it)->setResultVar(resultTemp.value);
+        leftTemp = resultTemp;
     }
 }
 
 void IRGenerator::visit(LetNode& node) {
-    auto identifier = std::dynamic_pointer_cast<IdentifierNode>(node.getIdentifier());
+    auto identifier = nodeCast<IdentifierNode>(node.getIdentifier());
     auto value = node.getValue();
 
     if (identifier && value) {
-        std::string valueTemp;
-        if (auto binaryOpNode = std::dynamic_pointer_cast<BinaryOperatorNode>(value)) {
-            // Visit the binary operation node to generate the instructions
-            binaryOpNode->accept(*this);
-            valueTemp = binaryOpNode->getResultVar();
-        } else {
-            valueTemp = handleLiteral(value);
-        }
+        IROperand valueTemp = handleLiteral(value);
 
         // generateInstruction(IRInstructionType::ALLOC, identifier->getName(), "", "");
-        generateInstruction(IRInstructionType::STORE, identifier->getName(), valueTemp, "");
+        generateInstruction(IRInstructionType::STORE, variable(identifier->getSymbol(), identifier->getBinding()), valueTemp,
+                            IROperand(), irType(identifier->getDataType()));
     }
 }
 
 void IRGenerator::visit(FunctionNode& node) {
+    beginFunction(node.getSymbol());
     for (const auto& bodyNode : node.getBodyNodes()) {
-        bodyNode->accept(*this);
+        dispatch(*bodyNode);
+    }
+    endFunction();
+}
+
+void IRGenerator::visit(ModuleNode& node) {
+    for (const auto& item : node.getItems()) {
+        dispatch(*item);
     }
-    generateInstruction(IRInstructionType::RET, "", "", "");
 }
 
 void IRGenerator::visit(NumberNode& node) {
-    generateInstruction(IRInstructionType::LOAD, newTempVar(), std::to_string(node.getValue()), "");
+    generateInstruction(IRInstructionType::LOAD, newTempVar(), IROperand::immediate(node.getValue()));
 }
 
 void IRGenerator::visit(IdentifierNode& node) {
-    generateInstruction(IRInstructionType::LOAD, newTempVar(), node.getName(), "");
+    generateInstruction(IRInstructionType::LOAD, newTempVar(), variable(node.getSymbol(), node.getBinding()), IROperand(),
+                        irType(node.getDataType()));
 }
 
 void IRGenerator::visit(BooleanLiteralNode& node) {
-    generateInstruction(IRInstructionType::LOAD, newTempVar(), node.getValue() ? "1" : "0", "");
+    generateInstruction(IRInstructionType::LOAD, newTempVar(), IROperand::immediate(node.getValue() ? 1 : 0), IROperand(),
+                        IRType::I8);
+}
+
+void IRGenerator::generateIR(const FlatAST& ast) {
+    generateFlat(ast, ast.root());
+}
+
+// Mirrors the visit methods above node for node, reading the arrays
+// instead of following pointers
+void IRGenerator::generateFlat(const FlatAST& ast, FlatNodeId node) {
+    switch (ast.kind(node)) {
+        case ASTNodeType::Number:
+        case ASTNodeType::Boolean:
+        case ASTNodeType::Identifier:
+            flatLiteral(ast, node);
+            break;
+        case ASTNodeType::BinaryExpression:
+            if (ast.isArithmetic(node)) {
+                flatBinary(ast, node);
+            }
+            break;
+        case ASTNodeType::VariableDeclaration: {
+            FlatNodeId identifier = ast.firstChild(node);
+            if (ast.kind(identifier) == ASTNodeType::Identifier) {
+                IROperand valueTemp = flatLiteral(ast, ast.nextSibling(identifier));
+                generateInstruction(IRInstructionType::STORE, variable(ast.payload(identifier), ast.binding(identifier)), valueTemp,
+                                    IROperand(), irType(ast.type(identifier)));
+            }
+            break;
+        }
+        case ASTNodeType::FunctionDeclaration: {
+            beginFunction(ast.function(node).name);
+            FlatNodeId child = ast.firstChild(node);
+            for (uint32_t i = 0; i < ast.function(node).paramCount; i++) {
+                child = ast.nextSibling(child);
+            }
+            for (; child != NoFlatNode; child = ast.nextSibling(child)) {
+                generateFlat(ast, child);
+            }
+            endFunction();
+            break;
+        }
+        case ASTNodeType::Module:
+            for (FlatNodeId item = ast.firstChild(node); item != NoFlatNode; item = ast.nextSibling(item)) {
+                generateFlat(ast, item);
+            }
+            break;
+    }
+}
+
+IROperand IRGenerator::flatLiteral(const FlatAST& ast, FlatNodeId node) {
+    switch (ast.kind(node)) {
+        case ASTNodeType::Number: {
+            IROperand tempVar = newTempVar();
+            generateInstruction(IRInstructionType::LOAD, tempVar, IROperand::immediate(ast.payload(node)));
+            return tempVar;
+        }
+        case ASTNodeType::Boolean: {
+            IROperand tempVar = newTempVar();
+            generateInstruction(IRInstructionType::LOAD, tempVar, IROperand::immediate(ast.payload(node)), IROperand(), IRType::I8);
+            return tempVar;
+        }
+        case ASTNodeType::Identifier: {
+            IROperand tempVar = newTempVar();
+            generateInstruction(IRInstructionType::LOAD, tempVar, variable(ast.payload(node), ast.binding(node)), IROperand(),
+                                irType(ast.type(node)));
+            return tempVar;
+        }
+        case ASTNodeType::BinaryExpression:
+            return ast.isArithmetic(node) ? flatBinary(ast, node) : IROperand();
+        default:
+            return IROperand();
+    }
+}
+
+IROperand IRGenerator::flatOperand(const FlatAST& ast, FlatNodeId node) {
+    return widen(flatLiteral(ast, node), ast.type(node));
+}
+
+IROperand IRGenerator::flatRightOperand(const FlatAST& ast, FlatNodeId node, IRInstructionType type) {
+    if (hasImmediateForm(type) && (ast.kind(node) == ASTNodeType::Number || ast.kind(node) == ASTNodeType::Boolean)) {
+        return IROperand::immediate(ast.payload(node));
+    }
+    return flatOperand(ast, node);
+}
+
+// Returns the temporary holding the result of the chain
+IROperand IRGenerator::flatBinary(const FlatAST& ast, FlatNodeId node) {
+    std::vector<FlatNodeId> chain{node};
+    while (ast.isArithmetic(ast.firstChild(chain.back()))) {
+        chain.push_back(ast.firstChild(chain.back()));
+    }
+
+    IROperand leftTemp = flatOperand(ast, ast.firstChild(chain.back()));
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        IRInstructionType type = binaryInstructionType(ast.token(*it));
+        IROperand rightTemp = flatRightOperand(ast, ast.nextSibling(ast.firstChild(*it)), type);
+        IROperand resultTemp = newTempVar();
+        generateInstruction(type, resultTemp, leftTemp, rightTemp);
+        leftTemp = resultTemp;
+    }
+    return leftTemp;
 }
@@ -0,0 +1,48 @@
+#include "loopInfo.h"
+#include <utility>
+
+LoopInfo::LoopInfo(const IRFunction& function, const DominatorTree& dominators)
+    : innermost(function.getBlockCount(), NoLoop) {
+    std::vector<bool> inLoop(function.getBlockCount(), false);
+    std::vector<BlockId> worklist;
+
+    // A header dominates its loop, so it comes before everything nested
+    // in it in reverse postorder. Visiting headers in that order finds
+    // outer loops first, and the last loop to claim a block is the
+    // innermost one containing it.
+    for (BlockId header : dominators.getReversePostorder()) {
+        worklist.clear();
+        for (BlockId predecessor : function.getBlock(header).predecessors) {
+            if (dominators.dominates(header, predecessor)) {
+                worklist.push_back(predecessor);
+            }
+        }
+        if (worklist.empty()) continue;
+
+        Loop loop;
+        loop.header = header;
+        loop.parent = innermost[header];
+        loop.depth = loop.parent == NoLoop ? 1 : loops[loop.parent].depth + 1;
+        loop.blocks.push_back(header);
+        inLoop[header] = true;
+        while (!worklist.empty()) {
+            BlockId block = worklist.back();
+            worklist.pop_back();
+            if (inLoop[block]) continue;
+            inLoop[block] = true;
+            loop.blocks.push_back(block);
+            for (BlockId predecessor : function.getBlock(block).predecessors) {
+                if (dominators.isReachable(predecessor)) {
+                    worklist.push_back(predecessor);
+                }
+            }
+        }
+
+        LoopId id = static_cast<LoopId>(loops.size());
+        for (BlockId block : loop.blocks) {
+            inLoop[block] = false;
+            innermost[block] = id;
+        }
+        loops.push_back(std::move(loop));
+    }
+}
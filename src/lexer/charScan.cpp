@@ -0,0 +1,214 @@
+#include "charScan.h"
+#include <cstring>
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define BM_HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+
+static constexpr std::array<uint8_t, 256> buildCharClassTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; c++) {
+        uint8_t bits = 0;
+        if (c == ' ' || (c >= '\t' && c <= '\r')) bits |= CharSpace;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) bits |= CharAlpha;
+        if (c >= '0' && c <= '9') bits |= CharDigit;
+        switch (c) {
+            case '(': case ')': case '{': case '}': case '=':
+            case '+': case '-': case '*': case '/':
+                bits |= CharPunct;
+        }
+        table[c] = bits;
+    }
+    return table;
+}
+
+const std::array<uint8_t, 256> charClassTable = buildCharClassTable();
+
+
+// Scalar kernels, also used for the tails shorter than a vector
+template <uint8_t Mask, bool Inside>
+static const char* scanScalar(const char* p, const char* end) {
+    while (p < end && static_cast<bool>(charClass(*p) & Mask) == Inside) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef BM_HAVE_SSE2
+
+// Byte-wise class membership, 0xFF where the byte belongs to the class.
+// Unsigned range checks are done as min(v - lo, width) == v - lo since
+// SSE2 has no unsigned byte compare.
+struct SSE2Classes {
+    static __m128i inRange(__m128i v, char lo, char width) {
+        __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(width)), t);
+    }
+    static __m128i eq(__m128i v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+
+    static __m128i space(__m128i v) { return _mm_or_si128(eq(v, ' '), inRange(v, '\t', '\r' - '\t')); }
+    static __m128i alpha(__m128i v) { return inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z' - 'a'); }
+    static __m128i digit(__m128i v) { return inRange(v, '0', 9); }
+    static __m128i punct(__m128i v) {
+        // '(' ')' '*' '+' are contiguous
+        __m128i m = inRange(v, '(', '+' - '(');
+        m = _mm_or_si128(m, _mm_or_si128(eq(v, '-'), eq(v, '/')));
+        m = _mm_or_si128(m, _mm_or_si128(eq(v, '='), eq(v, '{')));
+        return _mm_or_si128(m, eq(v, '}'));
+    }
+
+    template <uint8_t Mask>
+    static __m128i classify(__m128i v) {
+        switch (Mask) {
+            case CharSpace: return space(v);
+            case CharAlpha: return alpha(v);
+            case CharDigit: return digit(v);
+            default:        return _mm_or_si128(space(v), punct(v));
+        }
+    }
+};
+
+template <uint8_t Mask, bool Inside>
+static const char* scanSSE2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned stop = _mm_movemask_epi8(SSE2Classes::classify<Mask>(v));
+        if (Inside) stop = ~stop & 0xFFFF;
+        if (stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scanScalar<Mask, Inside>(p, end);
+}
+
+#define BM_AVX2 __attribute__((target("avx2")))
+
+struct AVX2Classes {
+    BM_AVX2 static __m256i inRange(__m256i v, char lo, char width) {
+        __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(width)), t);
+    }
+    BM_AVX2 static __m256i eq(__m256i v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+
+    BM_AVX2 static __m256i space(__m256i v) { return _mm256_or_si256(eq(v, ' '), inRange(v, '\t', '\r' - '\t')); }
+    BM_AVX2 static __m256i alpha(__m256i v) { return inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z' - 'a'); }
+    BM_AVX2 static __m256i digit(__m256i v) { return inRange(v, '0', 9); }
+    BM_AVX2 static __m256i punct(__m256i v) {
+        __m256i m = inRange(v, '(', '+' - '(');
+        m = _mm256_or_si256(m, _mm256_or_si256(eq(v, '-'), eq(v, '/')));
+        m = _mm256_or_si256(m, _mm256_or_si256(eq(v, '='), eq(v, '{')));
+        return _mm256_or_si256(m, eq(v, '}'));
+    }
+
+    template <uint8_t Mask>
+    BM_AVX2 static __m256i classify(__m256i v) {
+        switch (Mask) {
+            case CharSpace: return space(v);
+            case CharAlpha: return alpha(v);
+            case CharDigit: return digit(v);
+            default:        return _mm256_or_si256(space(v), punct(v));
+        }
+    }
+};
+
+template <uint8_t Mask, bool Inside>
+BM_AVX2 static const char* scanAVX2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned stop = _mm256_movemask_epi8(AVX2Classes::classify<Mask>(v));
+        if (Inside) stop = ~stop;
+        if (stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return scanSSE2<Mask, Inside>(p, end);
+}
+
+#endif // BM_HAVE_SSE2
+
+
+struct ScanKernels {
+    ScanMode mode;
+    const char* (*skipWhitespace)(const char*, const char*);
+    const char* (*scanAlpha)(const char*, const char*);
+    const char* (*scanDigits)(const char*, const char*);
+    const char* (*scanToDelimiter)(const char*, const char*);
+};
+
+static const ScanKernels scalarKernels = {
+    ScanMode::Scalar,
+    scanScalar<CharSpace, true>,
+    scanScalar<CharAlpha, true>,
+    scanScalar<CharDigit, true>,
+    scanScalar<CharSpace | CharPunct, false>,
+};
+
+#ifdef BM_HAVE_SSE2
+static const ScanKernels sse2Kernels = {
+    ScanMode::SSE2,
+    scanSSE2<CharSpace, true>,
+    scanSSE2<CharAlpha, true>,
+    scanSSE2<CharDigit, true>,
+    scanSSE2<CharSpace | CharPunct, false>,
+};
+
+static const ScanKernels avx2Kernels = {
+    ScanMode::AVX2,
+    scanAVX2<CharSpace, true>,
+    scanAVX2<CharAlpha, true>,
+    scanAVX2<CharDigit, true>,
+    scanAVX2<CharSpace | CharPunct, false>,
+};
+#endif
+
+static const ScanKernels* selectKernels(ScanMode mode) {
+#ifdef BM_HAVE_SSE2
+    __builtin_cpu_init();
+    bool hasAVX2 = __builtin_cpu_supports("avx2");
+    switch (mode) {
+        case ScanMode::Auto:   return hasAVX2 ? &avx2Kernels : &sse2Kernels;
+        case ScanMode::Scalar: return &scalarKernels;
+        case ScanMode::SSE2:   return &sse2Kernels;
+        case ScanMode::AVX2:   return hasAVX2 ? &avx2Kernels : nullptr;
+    }
+    return nullptr;
+#else
+    return (mode == ScanMode::Auto || mode == ScanMode::Scalar) ? &scalarKernels : nullptr;
+#endif
+}
+
+static const ScanKernels* kernels = selectKernels(ScanMode::Auto);
+
+bool setScanMode(ScanMode mode) {
+    const ScanKernels* selected = selectKernels(mode);
+    if (!selected) return false;
+    kernels = selected;
+    return true;
+}
+
+ScanMode getScanMode() {
+    return kernels->mode;
+}
+
+const char* skipWhitespace(const char* p, const char* end) {
+    return kernels->skipWhitespace(p, end);
+}
+
+const char* scanAlpha(const char* p, const char* end) {
+    return kernels->scanAlpha(p, end);
+}
+
+const char* scanDigits(const char* p, const char* end) {
+    return kernels->scanDigits(p, end);
+}
+
+const char* scanToDelimiter(const char* p, const char* end) {
+    return kernels->scanToDelimiter(p, end);
+}
+
+// glibc's memchr is already vectorized with the best ISA available, so
+// comment ends do not get a kernel of their own
+const char* findNewline(const char* p, const char* end) {
+    const void* newline = memchr(p, '\n', end - p);
+    return newline ? static_cast<const char*>(newline) : end;
+}
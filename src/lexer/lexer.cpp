@@ -1,119 +1,216 @@
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <iostream>
+#include <sstream>
 #include "lexer.h"
+#include "charScan.h"
+#include "threadPool.h"
 
 
-static bool isNumber(const std::string &str) {
-    for(char c : str) {
-        if(!isdigit(c)) return false;
-    }
-    return true;
+static bool isKeyword(std::string_view str) {
+    if(str == "def") return true;
+    return false;
 }
 
-static bool isAlpha(const std::string &str) {
-    for(char c : str) {
-        if(!isalpha(c)) return false;
+static TokenType punctuatorType(char c) {
+    switch(c) {
+        case '(': return TokenType::OpenParen;
+        case ')': return TokenType::ClosedParen;
+        case '{': return TokenType::OpenBracket;
+        case '}': return TokenType::ClosedBracket;
+        case '=': return TokenType::Equals;
+        case '+': return TokenType::Add;
+        case '-': return TokenType::Subtract;
+        case '*': return TokenType::Multiply;
+        default:  return TokenType::Divide;
     }
-    return true;
 }
 
-static bool isKeyword(const std::string &str) {
-    if(str == "def") return true;
-    return false;
+static TokenType wordType(std::string_view word) {
+    if (word == "let") return TokenType::Let;
+    if (isKeyword(word)) return TokenType::Keyword;
+    if (word == "True" || word == "False") return TokenType::BooleanLiteral;
+    return TokenType::Identifier;
 }
 
 
-static std::vector<std::string> splitString(std::string &words) {
-    std::vector<std::string> ret;
-    std::string curWord;
-    bool inComment = false;
+Lexer::Lexer(std::string_view source, StringInterner& interner)
+    : begin(source.data()), cursor(source.data()), end(source.data() + source.size()), interner(interner),
+      diagnostics(&std::cout) {}
 
-    for(int i = 0; i < words.size(); i++) {
+Lexer::Lexer(std::string_view chunk, StringInterner& interner, bool partial, bool insideComment)
+    : Lexer(chunk, interner) {
+    this->partial = partial;
+    this->insideComment = insideComment;
+}
+
+bool Lexer::next(Token& token) {
+    if(insideComment) {
+        cursor = findNewline(cursor, end);
+        if(cursor == end) return false;
+        insideComment = false;
+    }
 
-        // Handle Comments 
-        if(inComment) {
-            if(words[i] == '\n') inComment = false;
+    while(cursor < end) {
+        char c = *cursor;
+        uint8_t cls = charClass(c);
+
+        if(cls & CharSpace) {
+            cursor = skipWhitespace(cursor, end);
             continue;
         }
-        if( i < words.size()-1 && words[i] == '/' && words[i+1] == '/') {
-            inComment = true;
-            i++;
-            if(!curWord.empty()) {
-                ret.push_back(curWord);
-                curWord.clear();
-            }
+
+        // Handle Comments
+        if(c == '/' && cursor + 1 < end && cursor[1] == '/') {
+            cursor = findNewline(cursor + 2, end);
+            insideComment = partial && cursor == end;
             continue;
         }
+        if(c == '/' && cursor + 1 == end && partial) {
+            // Might be the first half of a comment
+            return false;
+        }
 
+        if(cls & CharPunct) {
+            token = Token{std::string_view(cursor, 1), punctuatorType(c)};
+            cursor++;
+            return true;
+        }
 
-        if(isspace(words[i])) {
-            if(!curWord.empty()) {
-                ret.push_back(curWord);
-                curWord.clear();
-            }
+        // Words are runs of anything that is neither whitespace nor a
+        // punctuator, only all-letter or all-digit words are valid
+        const char* start = cursor;
+        TokenType type = TokenType::End;
+        if(cls & CharAlpha) {
+            cursor = scanAlpha(cursor, end);
+            type = TokenType::Identifier;
+        } else if(cls & CharDigit) {
+            cursor = scanDigits(cursor, end);
+            type = TokenType::Number;
         }
-        else if (words[i] == '(' || words[i] == ')' || words[i] == '{' || words[i] == '}'\
-                || words[i] == '+' || words[i] == '-' || words[i] == '*' || words[i] == '/') {
-            if(!curWord.empty()) {
-                ret.push_back(curWord);
-                curWord.clear();
-            }
-            ret.push_back(std::string(1, words[i]));
+
+        if(cursor < end && !isDelimiter(*cursor)) {
+            cursor = scanToDelimiter(cursor, end);
+            type = TokenType::End;
+        }
+        if(cursor == end && partial) {
+            // The word may continue in the next chunk
+            cursor = start;
+            return false;
+        }
+
+        std::string_view word(start, cursor - start);
+        if(type == TokenType::End) {
+            *diagnostics << "Unrecognizable character found: " << word << std::endl;
+            continue;
         }
-        else {
-            curWord += words[i];
+
+        if(type == TokenType::Identifier) {
+            type = wordType(word);
         }
+        token = Token{word, type, type == TokenType::Identifier ? interner.intern(word) : InvalidSymbol};
+        return true;
     }
 
-    if (!curWord.empty()){
-        ret.push_back(curWord);
+    return false;
+}
+
+
+std::vector<Token> tokenize(std::string_view sourceCode) {
+    std::vector<Token> tokens;
+    // Rough guess at token density to avoid most of the regrowth copies
+    tokens.reserve(sourceCode.size() / 8);
+    Lexer lexer(sourceCode);
+
+    Token token;
+    while(lexer.next(token)) {
+        tokens.push_back(token);
     }
 
-    return ret;
+    return tokens;
 }
 
 
-std::vector<Token> tokenize(std::string &sourceCode) {
+// Pieces smaller than this are not worth a task of their own
+static constexpr size_t minParallelChunk = 256 * 1024;
 
-    std::vector<std::string> words = splitString(sourceCode);
+std::vector<Token> tokenize(std::string_view sourceCode, ThreadPool& pool) {
+    size_t chunkCount = std::min<size_t>(pool.size() * 4, sourceCode.size() / minParallelChunk);
+    if (chunkCount <= 1) {
+        return tokenize(sourceCode);
+    }
 
-    std::vector<Token> tokens;
-    while(!words.empty()) {
-        std::string word = words.front();
-        words.erase(words.begin());
-
-        if (word == "(") {
-            tokens.push_back(Token{word, TokenType::OpenParen});
-        } else if (word == "{") {
-            tokens.push_back(Token{word, TokenType::OpenBracket});
-        } else if (word == ")") {
-            tokens.push_back(Token{word, TokenType::ClosedParen});
-        } else if (word == "}") {
-            tokens.push_back(Token{word, TokenType::ClosedBracket});
-        } else if (word == "=") {
-            tokens.push_back(Token{word, TokenType::Equals});
-        } else if (word == "+") {
-            tokens.push_back(Token{word, TokenType::Add});
-        } else if (word == "-") {
-            tokens.push_back(Token{word, TokenType::Subtract});
-        } else if (word == "*") {
-            tokens.push_back(Token{word, TokenType::Multiply});
-        } else if (word == "/") {
-            tokens.push_back(Token{word, TokenType::Divide});
-        } else if (word == "let") {
-            tokens.push_back(Token{word, TokenType::Let});
-        } else if (isKeyword(word)) {
-            tokens.push_back(Token{word, TokenType::Keyword});
-        } else if (word == "True" || word == "False") {
-            tokens.push_back(Token{word, TokenType::BooleanLiteral});
-        } else if (isNumber(word)) {
-            tokens.push_back(Token{word, TokenType::Number});
-        } else if (isAlpha(word)) {
-            tokens.push_back(Token{word, TokenType::Identifier});
-        } else {
-            std::cout << "Unrecognizable character found: " << word << std::endl;
+    // Cut right after a newline. Comments end at a newline and words cannot
+    // span one, so every piece starts outside of any comment or token and
+    // can be lexed without knowing what came before it.
+    std::vector<std::string_view> chunks;
+    const char* start = sourceCode.data();
+    const char* end = sourceCode.data() + sourceCode.size();
+    size_t target = sourceCode.size() / chunkCount;
+    while (start < end) {
+        const char* cut = end;
+        if (static_cast<size_t>(end - start) > target) {
+            cut = findNewline(start + target, end);
+            if (cut < end) cut++;
+        }
+        chunks.emplace_back(start, cut - start);
+        start = cut;
+    }
+
+    // Each piece interns into its own pool, ids are reconciled afterwards
+    struct Piece {
+        std::unique_ptr<StringInterner> interner;
+        std::vector<Token> tokens;
+        std::ostringstream diagnostics;
+        std::vector<SymbolId> symbolMap;
+        size_t offset = 0;
+    };
+    std::vector<Piece> pieces(chunks.size());
+
+    pool.parallelFor(chunks.size(), [&](size_t i, unsigned) {
+        Piece& piece = pieces[i];
+        piece.interner.reset(new StringInterner());
+        piece.tokens.reserve(chunks[i].size() / 8);
+
+        Lexer lexer(chunks[i], *piece.interner);
+        lexer.setDiagnostics(piece.diagnostics);
+        Token token;
+        while (lexer.next(token)) {
+            piece.tokens.push_back(token);
+        }
+    });
+
+    // Local ids are in first-occurrence order, so interning the pieces'
+    // strings in piece order hands out the same global ids a serial pass would
+    StringInterner& global = StringInterner::global();
+    size_t total = 0;
+    for (Piece& piece : pieces) {
+        piece.symbolMap.resize(piece.interner->size());
+        for (SymbolId id = 0; id < piece.symbolMap.size(); id++) {
+            piece.symbolMap[id] = global.intern(piece.interner->lookup(id));
         }
+        piece.offset = total;
+        total += piece.tokens.size();
+        std::cout << piece.diagnostics.str();
     }
 
+    // Remapping the ids touches every token anyway, so tokens are written
+    // straight into their final slot by the same pass
+    std::vector<Token> tokens(total);
+    pool.parallelFor(pieces.size(), [&](size_t i, unsigned) {
+        Piece& piece = pieces[i];
+        Token* out = tokens.data() + piece.offset;
+        for (const Token& token : piece.tokens) {
+            *out = token;
+            if (token.symbol != InvalidSymbol) {
+                out->symbol = piece.symbolMap[token.symbol];
+            }
+            out++;
+        }
+        std::vector<Token>().swap(piece.tokens);
+        piece.interner.reset();
+    });
+
     return tokens;
-}
\ No newline at end of file
+}
@@ -0,0 +1,48 @@
+#include "sourceBuffer.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+SourceBuffer::SourceBuffer(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file " + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            // The lexer only ever walks forward
+            madvise(addr, st.st_size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(addr);
+            size = st.st_size;
+            mapped = true;
+            close(fd);
+            return;
+        }
+    }
+
+    // Not mappable, read it the slow way
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        fallback.append(chunk, n);
+    }
+    close(fd);
+    if (n < 0) {
+        throw std::runtime_error("Could not read file " + filename);
+    }
+
+    data = fallback.data();
+    size = fallback.size();
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
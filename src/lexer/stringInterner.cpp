@@ -0,0 +1,65 @@
+#include "stringInterner.h"
+#include <cstring>
+#include <functional>
+
+static constexpr size_t initialTableSize = 1024;
+static constexpr size_t blockSize = 64 * 1024;
+
+
+StringInterner::StringInterner() : table(initialTableSize, Slot{0, InvalidSymbol}) {}
+
+StringInterner& StringInterner::global() {
+    static StringInterner interner;
+    return interner;
+}
+
+SymbolId StringInterner::intern(std::string_view text) {
+    uint32_t hash = static_cast<uint32_t>(std::hash<std::string_view>()(text));
+    size_t mask = table.size() - 1;
+
+    // Linear probing, the table is kept at most half full
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Slot& slot = table[i];
+        if (slot.id == InvalidSymbol) {
+            SymbolId id = static_cast<SymbolId>(strings.size());
+            strings.emplace_back(store(text), text.size());
+            slot = Slot{hash, id};
+            if (strings.size() * 2 > table.size()) {
+                grow();
+            }
+            return id;
+        }
+        if (slot.hash == hash && strings[slot.id] == text) {
+            return slot.id;
+        }
+    }
+}
+
+const char* StringInterner::store(std::string_view text) {
+    if (text.size() > blockRemaining) {
+        size_t size = text.size() > blockSize ? text.size() : blockSize;
+        blocks.emplace_back(new char[size]);
+        blockCursor = blocks.back().get();
+        blockRemaining = size;
+    }
+    char* dest = blockCursor;
+    memcpy(dest, text.data(), text.size());
+    blockCursor += text.size();
+    blockRemaining -= text.size();
+    return dest;
+}
+
+void StringInterner::grow() {
+    std::vector<Slot> old(table.size() * 2, Slot{0, InvalidSymbol});
+    old.swap(table);
+
+    size_t mask = table.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == InvalidSymbol) continue;
+        size_t i = slot.hash & mask;
+        while (table[i].id != InvalidSymbol) {
+            i = (i + 1) & mask;
+        }
+        table[i] = slot;
+    }
+}
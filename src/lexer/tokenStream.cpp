@@ -0,0 +1,88 @@
+#include "tokenStream.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+ChunkedLexer::ChunkedLexer(const std::string& filename, size_t chunkSize, StringInterner& interner)
+    : chunkSize(chunkSize), interner(interner) {
+    if (filename == "-") {
+        fd = STDIN_FILENO;
+    } else {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open file " + filename);
+        }
+    }
+}
+
+ChunkedLexer::~ChunkedLexer() {
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+}
+
+bool ChunkedLexer::nextWindow(const Token*& begin, const Token*& end) {
+    window.clear();
+    numbers.swap(previousNumbers);
+    numbers.clear();
+
+    while (window.empty()) {
+        if (finished) return false;
+
+        // Keep the unfinished tail of the last chunk and append the next one
+        if (carrySize) {
+            memmove(buffer.data(), buffer.data() + carryBegin, carrySize);
+        }
+        buffer.resize(carrySize + chunkSize);
+
+        ssize_t n;
+        do {
+            n = read(fd, buffer.data() + carrySize, chunkSize);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            throw std::runtime_error("Could not read input");
+        }
+        finished = (n == 0);
+
+        size_t size = carrySize + n;
+        // Number text never outgrows the chunk, so the buffer is not
+        // reallocated under the tokens pointing into it
+        numbers.reserve(numbers.size() + size);
+        Lexer lexer(std::string_view(buffer.data(), size), interner, !finished, insideComment);
+        Token token;
+        while (lexer.next(token)) {
+            stabilize(token);
+            window.push_back(token);
+        }
+
+        carryBegin = lexer.consumed();
+        carrySize = size - carryBegin;
+        insideComment = lexer.isInsideComment();
+    }
+
+    begin = window.data();
+    end = window.data() + window.size();
+    return true;
+}
+
+void ChunkedLexer::stabilize(Token& token) {
+    static const char punctuators[] = "(){}=+-*/";
+    static const std::string_view words[] = {"def", "let", "True", "False"};
+
+    if (token.symbol != InvalidSymbol) {
+        token.value = interner.lookup(token.symbol);
+    } else if (token.type == TokenType::Number) {
+        size_t offset = numbers.size();
+        numbers.append(token.value);
+        token.value = std::string_view(numbers.data() + offset, token.value.size());
+    } else if (token.value.size() == 1 && strchr(punctuators, token.value[0])) {
+        token.value = std::string_view(strchr(punctuators, token.value[0]), 1);
+    } else {
+        for (std::string_view word : words) {
+            if (token.value == word) token.value = word;
+        }
+    }
+}
@@ -0,0 +1,343 @@
+#include "constantPropagation.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// Lattice value of a temporary
+struct Value {
+    enum State : uint8_t { Unknown, Constant, Overdefined };
+    State state = Unknown;
+    int32_t constant = 0;
+
+    static Value of(int32_t constant) { return Value{Constant, constant}; }
+    static Value overdefined() { return Value{Overdefined, 0}; }
+
+    bool operator==(const Value& other) const {
+        return state == other.state && (state != Constant || constant == other.constant);
+    }
+    bool operator!=(const Value& other) const { return !(*this == other); }
+};
+
+Value meet(Value a, Value b) {
+    if (a.state == Value::Unknown) return b;
+    if (b.state == Value::Unknown) return a;
+    if (a.state == Value::Overdefined || b.state == Value::Overdefined || a.constant != b.constant) {
+        return Value::overdefined();
+    }
+    return a;
+}
+
+// 32-bit two's complement arithmetic, false for the divisions that trap
+bool fold(IRInstructionType type, int32_t a, int32_t b, int32_t& result) {
+    uint32_t ua = static_cast<uint32_t>(a);
+    uint32_t ub = static_cast<uint32_t>(b);
+    switch (type) {
+        case IRInstructionType::ADD:
+            result = static_cast<int32_t>(ua + ub);
+            return true;
+        case IRInstructionType::SUB:
+            result = static_cast<int32_t>(ua - ub);
+            return true;
+        case IRInstructionType::MUL:
+            result = static_cast<int32_t>(ua * ub);
+            return true;
+        case IRInstructionType::DIV:
+            if (b == 0 || (a == INT_MIN && b == -1)) {
+                return false;
+            }
+            result = a / b;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isArithmetic(IRInstructionType type) {
+    return type == IRInstructionType::ADD || type == IRInstructionType::SUB || type == IRInstructionType::MUL
+        || type == IRInstructionType::DIV;
+}
+
+// Replaces loads of a variable by copies of the value stored to it
+// earlier in the same block. Only stores write variables, so nothing in
+// between can change it.
+void forwardStores(IRFunction& function) {
+    std::vector<IRInstruction>& instructions = function.getInstructions();
+    std::unordered_map<uint32_t, IROperand> stored;
+    for (const auto& block : function.getBlocks()) {
+        stored.clear();
+        for (uint32_t i = block.begin; i < block.end; i++) {
+            IRInstruction& instruction = instructions[i];
+            if (instruction.type == IRInstructionType::STORE && instruction.dest().kind == IROperandKind::Variable) {
+                stored[instruction.dest().value] = instruction.src1();
+            } else if (instruction.type == IRInstructionType::LOAD && instruction.src1().kind == IROperandKind::Variable) {
+                auto it = stored.find(instruction.src1().value);
+                if (it != stored.end()) {
+                    instruction.setOperand(1, it->second);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+size_t propagateConstants(IRFunction& function) {
+    size_t blockCount = function.getBlockCount();
+    if (blockCount == 0) return 0;
+    forwardStores(function);
+
+    std::vector<IRInstruction>& instructions = function.getInstructions();
+    const std::vector<BasicBlock>& blocks = function.getBlocks();
+
+    // Block of every instruction, and the temporaries in use
+    std::vector<BlockId> blockOf(instructions.size());
+    uint32_t tempBegin = UINT32_MAX;
+    uint32_t tempEnd = 0;
+    for (BlockId b = 0; b < blockCount; b++) {
+        for (uint32_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            blockOf[i] = b;
+            IROperand dest = instructions[i].dest();
+            if (dest.kind == IROperandKind::Temp) {
+                tempBegin = std::min(tempBegin, dest.value);
+                tempEnd = std::max(tempEnd, dest.value + 1);
+            }
+        }
+    }
+    if (tempBegin >= tempEnd) return 0;
+
+    auto isLocalTemp = [&](IROperand operand) {
+        return operand.kind == IROperandKind::Temp && operand.value >= tempBegin && operand.value < tempEnd;
+    };
+
+    // Users of each temporary, as offsets into one array
+    std::vector<uint32_t> userOffsets(tempEnd - tempBegin + 1, 0);
+    auto forEachUse = [&](uint32_t i, auto&& visit) {
+        const IRInstruction& instruction = instructions[i];
+        if (instruction.type == IRInstructionType::PHI) {
+            const IROperand* incoming = function.phiIncoming(instruction);
+            for (size_t k = 0; k < blocks[blockOf[i]].predecessors.size(); k++) {
+                if (isLocalTemp(incoming[k])) visit(incoming[k].value - tempBegin);
+            }
+            return;
+        }
+        if (isLocalTemp(instruction.src1())) visit(instruction.src1().value - tempBegin);
+        if (isLocalTemp(instruction.src2())) visit(instruction.src2().value - tempBegin);
+    };
+    for (uint32_t i = 0; i < instructions.size(); i++) {
+        forEachUse(i, [&](uint32_t temp) { userOffsets[temp + 1]++; });
+    }
+    for (size_t t = 1; t < userOffsets.size(); t++) {
+        userOffsets[t] += userOffsets[t - 1];
+    }
+    std::vector<uint32_t> users(userOffsets.back());
+    {
+        std::vector<uint32_t> fill(userOffsets.begin(), userOffsets.end() - 1);
+        for (uint32_t i = 0; i < instructions.size(); i++) {
+            forEachUse(i, [&](uint32_t temp) { users[fill[temp]++] = i; });
+        }
+    }
+
+    // Temporaries defined outside the function are not known here
+    std::vector<Value> values(tempEnd - tempBegin, Value());
+    std::vector<bool> defined(tempEnd - tempBegin, false);
+    for (const auto& instruction : instructions) {
+        if (isLocalTemp(instruction.dest())) {
+            defined[instruction.dest().value - tempBegin] = true;
+        }
+    }
+    for (size_t t = 0; t < values.size(); t++) {
+        if (!defined[t]) values[t] = Value::overdefined();
+    }
+
+    auto valueOf = [&](IROperand operand) {
+        switch (operand.kind) {
+            case IROperandKind::Immediate:
+                return Value::of(operand.getImmediate());
+            case IROperandKind::Temp:
+                return isLocalTemp(operand) ? values[operand.value - tempBegin] : Value::overdefined();
+            default:
+                return Value::overdefined();
+        }
+    };
+
+    std::vector<bool> executable(blockCount, false);
+    std::vector<std::vector<bool>> edgeExecutable(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        edgeExecutable[b].assign(blocks[b].predecessors.size(), false);
+    }
+    std::vector<std::pair<BlockId, BlockId>> edgeWorklist;
+    std::vector<uint32_t> instructionWorklist;
+
+    auto markEdge = [&](BlockId from, BlockId to) {
+        const std::vector<BlockId>& predecessors = blocks[to].predecessors;
+        size_t k = std::find(predecessors.begin(), predecessors.end(), from) - predecessors.begin();
+        if (!edgeExecutable[to][k]) {
+            edgeExecutable[to][k] = true;
+            edgeWorklist.emplace_back(from, to);
+        }
+    };
+
+    auto evaluate = [&](uint32_t i) {
+        const IRInstruction& instruction = instructions[i];
+        BlockId b = blockOf[i];
+        switch (instruction.type) {
+            case IRInstructionType::PHI: {
+                Value result;
+                const IROperand* incoming = function.phiIncoming(instruction);
+                for (size_t k = 0; k < blocks[b].predecessors.size(); k++) {
+                    if (edgeExecutable[b][k] && !incoming[k].isNone()) {
+                        result = meet(result, valueOf(incoming[k]));
+                    }
+                }
+                return result;
+            }
+            case IRInstructionType::LOAD:
+                return valueOf(instruction.src1());
+            case IRInstructionType::ZEXT: {
+                Value source = valueOf(instruction.src1());
+                return source.state == Value::Constant ? Value::of(source.constant & 0xFF) : source;
+            }
+            case IRInstructionType::ADD:
+            case IRInstructionType::SUB:
+            case IRInstructionType::MUL:
+            case IRInstructionType::DIV: {
+                Value a = valueOf(instruction.src1());
+                Value b = valueOf(instruction.src2());
+                if (a.state == Value::Overdefined || b.state == Value::Overdefined) return Value::overdefined();
+                if (a.state == Value::Unknown || b.state == Value::Unknown) return Value();
+                int32_t result;
+                return fold(instruction.type, a.constant, b.constant, result) ? Value::of(result) : Value::overdefined();
+            }
+            default:
+                return Value::overdefined();
+        }
+    };
+
+    auto visit = [&](uint32_t i) {
+        const IRInstruction& instruction = instructions[i];
+        BlockId b = blockOf[i];
+        switch (instruction.type) {
+            case IRInstructionType::JMP:
+                markEdge(b, instruction.src1().value);
+                return;
+            case IRInstructionType::BR: {
+                Value condition = valueOf(instruction.src1());
+                if (condition.state == Value::Unknown) return;
+                if (condition.state == Value::Overdefined || condition.constant != 0) markEdge(b, instruction.dest().value);
+                if (condition.state == Value::Overdefined || condition.constant == 0) markEdge(b, instruction.src2().value);
+                return;
+            }
+            default:
+                break;
+        }
+        if (!isLocalTemp(instruction.dest())) return;
+
+        Value& current = values[instruction.dest().value - tempBegin];
+        Value updated = meet(current, evaluate(i));
+        if (updated != current) {
+            current = updated;
+            uint32_t temp = instruction.dest().value - tempBegin;
+            for (uint32_t u = userOffsets[temp]; u < userOffsets[temp + 1]; u++) {
+                if (executable[blockOf[users[u]]]) instructionWorklist.push_back(users[u]);
+            }
+        }
+    };
+
+    auto enterBlock = [&](BlockId b) {
+        executable[b] = true;
+        for (uint32_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            visit(i);
+        }
+    };
+
+    enterBlock(function.entry());
+    while (!edgeWorklist.empty() || !instructionWorklist.empty()) {
+        if (!edgeWorklist.empty()) {
+            BlockId to = edgeWorklist.back().second;
+            edgeWorklist.pop_back();
+            if (!executable[to]) {
+                enterBlock(to);
+            } else {
+                // Another edge into a block already running, only its phis
+                // can change
+                for (uint32_t i = blocks[to].begin; i < blocks[to].end; i++) {
+                    if (instructions[i].type == IRInstructionType::PHI) visit(i);
+                }
+            }
+            continue;
+        }
+        uint32_t i = instructionWorklist.back();
+        instructionWorklist.pop_back();
+        visit(i);
+    }
+
+    // Rewrite with what was found
+    auto constantOf = [&](IROperand operand) {
+        Value value = valueOf(operand);
+        return operand.kind == IROperandKind::Temp && value.state == Value::Constant
+            ? IROperand::immediate(value.constant) : operand;
+    };
+    size_t folded = 0;
+    bool branchesChanged = false;
+    for (BlockId b = 0; b < blockCount; b++) {
+        if (!executable[b]) continue;
+        for (uint32_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            IRInstruction& instruction = instructions[i];
+            switch (instruction.type) {
+                case IRInstructionType::PHI: {
+                    IROperand* incoming = function.phiIncoming(instruction);
+                    for (size_t k = 0; k < blocks[b].predecessors.size(); k++) {
+                        incoming[k] = constantOf(incoming[k]);
+                    }
+                    break;
+                }
+                case IRInstructionType::LOAD:
+                case IRInstructionType::STORE:
+                    instruction.setOperand(1, constantOf(instruction.src1()));
+                    break;
+                case IRInstructionType::ADD:
+                case IRInstructionType::SUB:
+                case IRInstructionType::MUL: {
+                    IROperand left = constantOf(instruction.src1());
+                    IROperand right = constantOf(instruction.src2());
+                    // Only the second operand has an immediate form
+                    if (left.isImmediate() && !right.isImmediate() && instruction.type != IRInstructionType::SUB) {
+                        instruction.setOperand(1, instruction.src2());
+                        instruction.setOperand(2, left);
+                    } else if (right.isImmediate()) {
+                        instruction.setOperand(2, right);
+                    }
+                    break;
+                }
+                case IRInstructionType::BR: {
+                    Value condition = valueOf(instruction.src1());
+                    if (condition.state == Value::Constant) {
+                        BlockId target = condition.constant != 0 ? instruction.dest().value : instruction.src2().value;
+                        instruction = IRInstruction(IRInstructionType::JMP, IROperand(), IROperand::immediate(target),
+                                                    IROperand(), IRType::Void);
+                        branchesChanged = true;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            bool computes = instruction.type == IRInstructionType::PHI || instruction.type == IRInstructionType::ZEXT
+                || isArithmetic(instruction.type);
+            Value result = isLocalTemp(instruction.dest()) ? values[instruction.dest().value - tempBegin] : Value();
+            if (computes && result.state == Value::Constant) {
+                instruction = IRInstruction(IRInstructionType::LOAD, instruction.dest(), IROperand::immediate(result.constant),
+                                            IROperand(), instruction.valueType);
+                folded++;
+            }
+        }
+    }
+    if (branchesChanged) {
+        function.buildCFG();
+    }
+    return folded;
+}
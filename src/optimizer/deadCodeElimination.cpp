@@ -0,0 +1,147 @@
+#include "deadCodeElimination.h"
+#include <algorithm>
+
+namespace {
+
+// Blocks the entry cannot reach, marked true
+std::vector<bool> unreachableBlocks(const IRFunction& function) {
+    std::vector<bool> unreachable(function.getBlockCount(), true);
+    std::vector<BlockId> worklist{function.entry()};
+    unreachable[function.entry()] = false;
+    while (!worklist.empty()) {
+        BlockId b = worklist.back();
+        worklist.pop_back();
+        for (BlockId successor : function.getBlock(b).successors) {
+            if (unreachable[successor]) {
+                unreachable[successor] = false;
+                worklist.push_back(successor);
+            }
+        }
+    }
+    return unreachable;
+}
+
+bool hasSideEffects(const IRInstruction& instruction, const std::vector<int32_t>& constantDivisors) {
+    switch (instruction.type) {
+        case IRInstructionType::ADD:
+        case IRInstructionType::SUB:
+        case IRInstructionType::MUL:
+        case IRInstructionType::LOAD:
+        case IRInstructionType::ZEXT:
+        case IRInstructionType::PHI:
+            return instruction.dest().kind != IROperandKind::Temp;
+        case IRInstructionType::DIV: {
+            // Only a divisor known not to be 0 or -1 cannot trap
+            IROperand divisor = instruction.src2();
+            int32_t value = divisor.isImmediate() ? divisor.getImmediate()
+                : divisor.kind == IROperandKind::Temp && divisor.value < constantDivisors.size() ? constantDivisors[divisor.value] : 0;
+            return value == 0 || value == -1 || instruction.dest().kind != IROperandKind::Temp;
+        }
+        default:
+            return true;
+    }
+}
+
+} // namespace
+
+DeadCodeStats eliminateDeadCode(IRFunction& function) {
+    DeadCodeStats stats;
+    if (function.getBlockCount() == 0) return stats;
+
+    std::vector<bool> unreachable = unreachableBlocks(function);
+    size_t before = function.getInstructions().size();
+    stats.blocks = std::count(unreachable.begin(), unreachable.end(), true);
+    if (stats.blocks) {
+        function.removeBlocks(unreachable);
+        stats.instructions = before - function.getInstructions().size();
+    }
+
+    const std::vector<IRInstruction>& instructions = function.getInstructions();
+    const std::vector<BasicBlock>& blocks = function.getBlocks();
+    uint32_t tempEnd = 0;
+    for (const auto& instruction : instructions) {
+        if (instruction.dest().kind == IROperandKind::Temp) {
+            tempEnd = std::max(tempEnd, instruction.dest().value + 1);
+        }
+    }
+
+    // Definitions of each temporary, as offsets into one array, and the
+    // temporaries that only ever hold one constant
+    std::vector<uint32_t> defOffsets(tempEnd + 1, 0);
+    std::vector<int32_t> constants(tempEnd, 0);
+    for (const auto& instruction : instructions) {
+        if (instruction.dest().kind != IROperandKind::Temp || instruction.type == IRInstructionType::BR) continue;
+        uint32_t temp = instruction.dest().value;
+        bool constant = instruction.type == IRInstructionType::LOAD && instruction.src1().isImmediate();
+        constants[temp] = constant && defOffsets[temp + 1] == 0 ? instruction.src1().getImmediate() : 0;
+        defOffsets[temp + 1]++;
+    }
+    for (size_t t = 1; t < defOffsets.size(); t++) {
+        defOffsets[t] += defOffsets[t - 1];
+    }
+    std::vector<uint32_t> defs(defOffsets.back());
+    {
+        std::vector<uint32_t> fill(defOffsets.begin(), defOffsets.end() - 1);
+        for (uint32_t i = 0; i < instructions.size(); i++) {
+            const IRInstruction& instruction = instructions[i];
+            if (instruction.dest().kind == IROperandKind::Temp && instruction.type != IRInstructionType::BR) {
+                defs[fill[instruction.dest().value]++] = i;
+            }
+        }
+    }
+
+    std::vector<bool> live(instructions.size(), false);
+    std::vector<bool> liveTemps(tempEnd, false);
+    std::vector<uint32_t> worklist;
+    auto markTemp = [&](IROperand operand) {
+        if (operand.kind != IROperandKind::Temp || operand.value >= tempEnd || liveTemps[operand.value]) return;
+        liveTemps[operand.value] = true;
+        for (uint32_t d = defOffsets[operand.value]; d < defOffsets[operand.value + 1]; d++) {
+            if (!live[defs[d]]) {
+                live[defs[d]] = true;
+                worklist.push_back(defs[d]);
+            }
+        }
+    };
+
+    // Phi operands are found through the block holding the phi
+    std::vector<BlockId> blockOf(instructions.size());
+    for (BlockId b = 0; b < blocks.size(); b++) {
+        for (uint32_t i = blocks[b].begin; i < blocks[b].end; i++) {
+            blockOf[i] = b;
+            if (hasSideEffects(instructions[i], constants)) {
+                live[i] = true;
+                worklist.push_back(i);
+            }
+        }
+    }
+    while (!worklist.empty()) {
+        const IRInstruction& instruction = instructions[worklist.back()];
+        BlockId b = blockOf[worklist.back()];
+        worklist.pop_back();
+        if (instruction.type == IRInstructionType::PHI) {
+            const IROperand* incoming = function.phiIncoming(instruction);
+            for (size_t k = 0; k < blocks[b].predecessors.size(); k++) {
+                markTemp(incoming[k]);
+            }
+        } else {
+            markTemp(instruction.src1());
+            markTemp(instruction.src2());
+        }
+    }
+
+    size_t removed = std::count(live.begin(), live.end(), false);
+    if (removed == 0) return stats;
+    std::vector<IRInstruction> kept;
+    kept.reserve(instructions.size() - removed);
+    std::vector<uint32_t> blockEnds;
+    for (const auto& block : blocks) {
+        for (uint32_t i = block.begin; i < block.end; i++) {
+            if (live[i]) kept.push_back(instructions[i]);
+        }
+        blockEnds.push_back(static_cast<uint32_t>(kept.size()));
+    }
+    function.replaceInstructions(std::move(kept), blockEnds);
+    stats.instructions += removed;
+    return stats;
+}
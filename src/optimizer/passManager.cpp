@@ -0,0 +1,240 @@
+#include "passManager.h"
+#include "dominatorTree.h"
+#include "loopInfo.h"
+#include "ssa.h"
+#include "constantPropagation.h"
+#include "valueNumbering.h"
+#include "deadCodeElimination.h"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+struct AnalysisInfo {
+    std::string name;
+    bool onlyCFG;
+    std::function<std::shared_ptr<const void>(const IRFunction&, AnalysisManager&)> factory;
+};
+
+size_t edgeCount(const IRFunction& function) {
+    size_t edges = 0;
+    for (const auto& block : function.getBlocks()) {
+        edges += block.successors.size();
+    }
+    return edges;
+}
+
+// Changed instructions only, or nothing at all
+PassResult instructionsChanged(size_t changes) {
+    return PassResult{changes, changes ? Preserved::CFG : Preserved::All};
+}
+
+std::unordered_map<AnalysisId, AnalysisInfo>& analysisRegistry() {
+    static std::unordered_map<AnalysisId, AnalysisInfo> registry = [] {
+        std::unordered_map<AnalysisId, AnalysisInfo> builtins;
+        builtins[analysisId<DominatorTree>()] = AnalysisInfo{"dominators", true,
+            [](const IRFunction& function, AnalysisManager&) {
+                return std::shared_ptr<const void>(std::make_shared<DominatorTree>(function));
+            }};
+        builtins[analysisId<LoopInfo>()] = AnalysisInfo{"loops", true,
+            [](const IRFunction& function, AnalysisManager& analyses) {
+                return std::shared_ptr<const void>(std::make_shared<LoopInfo>(function, analyses.get<DominatorTree>()));
+            }};
+        return builtins;
+    }();
+    return registry;
+}
+
+std::map<std::string, Transform>& passRegistry() {
+    static std::map<std::string, Transform> registry = {
+        {"ssa", [](IRFunction& function, AnalysisManager& analyses, uint32_t& nextTemp) {
+            size_t before = function.getInstructions().size();
+            constructSSA(function, nextTemp, analyses.get<DominatorTree>());
+            size_t after = function.getInstructions().size();
+            return instructionsChanged(before > after ? before - after : after - before);
+        }},
+        {"sccp", [](IRFunction& function, AnalysisManager&, uint32_t&) {
+            size_t edges = edgeCount(function);
+            PassResult result = instructionsChanged(propagateConstants(function));
+            // Branches folded to jumps drop edges
+            if (edgeCount(function) != edges) {
+                result.preserved = Preserved::Nothing;
+            }
+            return result;
+        }},
+        {"gvn", [](IRFunction& function, AnalysisManager& analyses, uint32_t&) {
+            return instructionsChanged(numberValues(function, analyses.get<DominatorTree>()));
+        }},
+        {"dce", [](IRFunction& function, AnalysisManager&, uint32_t&) {
+            DeadCodeStats removed = eliminateDeadCode(function);
+            PassResult result = instructionsChanged(removed.instructions);
+            if (removed.blocks) {
+                result.preserved = Preserved::Nothing;
+            }
+            return result;
+        }},
+        {"out-of-ssa", [](IRFunction& function, AnalysisManager&, uint32_t& nextTemp) {
+            size_t before = function.getInstructions().size();
+            destroySSA(function, nextTemp);
+            return instructionsChanged(function.getInstructions().size() - before);
+        }},
+    };
+    return registry;
+}
+
+} // namespace
+
+PassStatistics& PassStatistics::operator+=(const PassStatistics& other) {
+    if (passes.empty()) {
+        passes = other.passes;
+    } else {
+        for (size_t p = 0; p < passes.size() && p < other.passes.size(); p++) {
+            passes[p].runs += other.passes[p].runs;
+            passes[p].seconds += other.passes[p].seconds;
+            passes[p].instructionsBefore += other.passes[p].instructionsBefore;
+            passes[p].instructionsAfter += other.passes[p].instructionsAfter;
+            passes[p].changes += other.passes[p].changes;
+        }
+    }
+    for (const auto& analysis : other.analyses) {
+        analyses[analysis.first] += analysis.second;
+    }
+    return *this;
+}
+
+void PassStatistics::print(std::ostream& os) const {
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::dec << std::left << std::setfill(' ');
+    os << std::setw(12) << "Pass" << std::right << std::setw(8) << "Runs" << std::setw(12) << "Time (ms)"
+       << std::setw(10) << "Before" << std::setw(10) << "After" << std::setw(10) << "Changes" << std::endl;
+    double total = 0;
+    for (const auto& pass : passes) {
+        os << std::left << std::setw(12) << pass.name << std::right << std::setw(8) << pass.runs
+           << std::setw(12) << std::fixed << std::setprecision(3) << pass.seconds * 1000
+           << std::setw(10) << pass.instructionsBefore << std::setw(10) << pass.instructionsAfter
+           << std::setw(10) << pass.changes << std::endl;
+        total += pass.seconds;
+    }
+    os << "Total " << std::fixed << std::setprecision(3) << total * 1000 << " ms" << std::endl;
+    for (const auto& analysis : analyses) {
+        os << "Computed " << analysis.first << " " << analysis.second << " times" << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+const void* AnalysisManager::get(AnalysisId id) {
+    auto cached = cache.find(id);
+    if (cached != cache.end()) {
+        return cached->second.result.get();
+    }
+    auto& registry = analysisRegistry();
+    auto info = registry.find(id);
+    if (info == registry.end()) {
+        throw std::logic_error("Analysis is not registered");
+    }
+    std::shared_ptr<const void> result = info->second.factory(function, *this);
+    if (stats) {
+        stats->analyses[info->second.name]++;
+    }
+    const void* analysis = result.get();
+    cache[id] = Cached{std::move(result), info->second.onlyCFG};
+    return analysis;
+}
+
+void AnalysisManager::invalidate(Preserved preserved) {
+    if (preserved == Preserved::All) return;
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (preserved == Preserved::Nothing || !it->second.onlyCFG) {
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void AnalysisManager::registerAnalysis(AnalysisId id, const std::string& name, bool onlyCFG, ErasedFactory factory) {
+    analysisRegistry()[id] = AnalysisInfo{name, onlyCFG, std::move(factory)};
+}
+
+PassManager::PassManager(std::vector<std::string> names) : names(std::move(names)) {
+    size_t lastSSA = this->names.size();
+    for (size_t p = 0; p < this->names.size(); p++) {
+        if (this->names[p] == "ssa") {
+            lastSSA = p;
+        } else if (this->names[p] == "out-of-ssa") {
+            lastSSA = this->names.size();
+        }
+    }
+    if (lastSSA < this->names.size()) {
+        this->names.push_back("out-of-ssa");
+    }
+
+    const auto& registry = passRegistry();
+    for (const auto& name : this->names) {
+        auto pass = registry.find(name);
+        if (pass == registry.end()) {
+            throw std::invalid_argument("Unknown pass " + name);
+        }
+        transforms.push_back(pass->second);
+    }
+}
+
+PassManager PassManager::forLevel(unsigned level) {
+    switch (level) {
+        case 0:
+            return PassManager({});
+        case 1:
+            return PassManager({"ssa", "sccp", "dce", "out-of-ssa"});
+        case 2:
+            return PassManager({"ssa", "sccp", "gvn", "dce", "out-of-ssa"});
+        default:
+            throw std::invalid_argument("Unknown optimization level " + std::to_string(level));
+    }
+}
+
+PassManager PassManager::parse(const std::string& list) {
+    std::vector<std::string> names;
+    std::istringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (!name.empty()) names.push_back(name);
+    }
+    return PassManager(std::move(names));
+}
+
+void PassManager::registerPass(const std::string& name, Transform transform) {
+    passRegistry()[name] = std::move(transform);
+}
+
+std::vector<std::string> PassManager::getRegisteredPasses() {
+    std::vector<std::string> registered;
+    for (const auto& pass : passRegistry()) {
+        registered.push_back(pass.first);
+    }
+    return registered;
+}
+
+void PassManager::run(IRFunction& function, uint32_t& nextTemp, PassStatistics& stats) const {
+    if (stats.passes.empty()) {
+        for (const auto& name : names) {
+            stats.passes.emplace_back();
+            stats.passes.back().name = name;
+        }
+    }
+    AnalysisManager analyses(function, &stats);
+    for (size_t p = 0; p < transforms.size(); p++) {
+        PassStatistics::Pass& pass = stats.passes[p];
+        pass.instructionsBefore += function.getInstructions().size();
+        auto start = std::chrono::steady_clock::now();
+        PassResult result = transforms[p](function, analyses, nextTemp);
+        pass.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        pass.instructionsAfter += function.getInstructions().size();
+        pass.changes += result.changes;
+        pass.runs++;
+        analyses.invalidate(result.preserved);
+    }
+}
@@ -0,0 +1,250 @@
+#include "ssa.h"
+#include <algorithm>
+#include <utility>
+
+static constexpr uint32_t NoIndex = UINT32_MAX;
+
+static IRInstruction copy(IROperand dest, IROperand source, IRType type) {
+    return IRInstruction(IRInstructionType::LOAD, dest, source, IROperand(), type);
+}
+
+void constructSSA(IRFunction& function, uint32_t& nextTemp) {
+    constructSSA(function, nextTemp, DominatorTree(function));
+}
+
+void constructSSA(IRFunction& function, uint32_t& nextTemp, const DominatorTree& dominators) {
+    const std::vector<uint32_t>& locals = function.getLocalVariables();
+    size_t blockCount = function.getBlockCount();
+    // Values loaded at the entry would be reloaded if it could be entered
+    // again, which generated code never does
+    if (locals.empty() || blockCount == 0 || !function.getBlock(function.entry()).predecessors.empty()) {
+        return;
+    }
+
+    const std::vector<IRInstruction>& instructions = function.getInstructions();
+    uint32_t variableLimit = *std::max_element(locals.begin(), locals.end()) + 1;
+    std::vector<uint32_t> promoted(variableLimit, NoIndex);
+    for (uint32_t i = 0; i < locals.size(); i++) {
+        promoted[locals[i]] = i;
+    }
+    auto promotedIndex = [&](IROperand operand) {
+        return operand.kind == IROperandKind::Variable && operand.value < variableLimit ? promoted[operand.value] : NoIndex;
+    };
+
+    // Blocks storing each variable, and the range of temporaries in use so
+    // replacements can be kept in a flat array
+    size_t count = locals.size();
+    std::vector<std::vector<BlockId>> storeBlocks(count);
+    std::vector<IRType> types(count, IRType::I32);
+    uint32_t tempBegin = UINT32_MAX;
+    uint32_t tempEnd = 0;
+    for (BlockId b = 0; b < blockCount; b++) {
+        for (uint32_t i = function.getBlock(b).begin; i < function.getBlock(b).end; i++) {
+            const IRInstruction& instruction = instructions[i];
+            IROperand dest = instruction.dest();
+            if (dest.kind == IROperandKind::Temp) {
+                tempBegin = std::min(tempBegin, dest.value);
+                tempEnd = std::max(tempEnd, dest.value + 1);
+            }
+            uint32_t v;
+            if (instruction.type == IRInstructionType::STORE && (v = promotedIndex(dest)) != NoIndex) {
+                if (storeBlocks[v].empty() || storeBlocks[v].back() != b) {
+                    storeBlocks[v].push_back(b);
+                }
+                types[v] = instruction.valueType;
+            } else if (instruction.type == IRInstructionType::LOAD && (v = promotedIndex(instruction.src1())) != NoIndex) {
+                types[v] = instruction.valueType;
+            }
+        }
+    }
+    if (tempBegin > tempEnd) {
+        tempBegin = tempEnd;
+    }
+
+    // Dominance frontiers, walking up from the predecessors of every join
+    std::vector<std::vector<BlockId>> frontiers(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        const std::vector<BlockId>& predecessors = function.getBlock(b).predecessors;
+        if (predecessors.size() < 2 || !dominators.isReachable(b)) continue;
+        for (BlockId predecessor : predecessors) {
+            if (!dominators.isReachable(predecessor)) continue;
+            for (BlockId runner = predecessor; runner != dominators.getIdom(b); runner = dominators.getIdom(runner)) {
+                if (frontiers[runner].empty() || frontiers[runner].back() != b) {
+                    frontiers[runner].push_back(b);
+                }
+            }
+        }
+    }
+
+    // Phis at the iterated dominance frontier of each variable's stores
+    std::vector<std::vector<uint32_t>> phiVariables(blockCount);
+    std::vector<uint32_t> placed(blockCount, NoIndex);
+    std::vector<uint32_t> queued(blockCount, NoIndex);
+    std::vector<BlockId> worklist;
+    for (uint32_t v = 0; v < count; v++) {
+        worklist = storeBlocks[v];
+        for (BlockId b : worklist) {
+            queued[b] = v;
+        }
+        while (!worklist.empty()) {
+            BlockId b = worklist.back();
+            worklist.pop_back();
+            for (BlockId frontier : frontiers[b]) {
+                if (placed[frontier] == v) continue;
+                placed[frontier] = v;
+                phiVariables[frontier].push_back(v);
+                if (queued[frontier] != v) {
+                    queued[frontier] = v;
+                    worklist.push_back(frontier);
+                }
+            }
+        }
+    }
+    std::vector<std::vector<IRInstruction>> phis(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        for (uint32_t v : phiVariables[b]) {
+            phis[b].push_back(function.makePhi(IROperand::temp(nextTemp++), types[v],
+                                               static_cast<uint32_t>(function.getBlock(b).predecessors.size())));
+        }
+    }
+
+    // Renaming. Temporaries are defined once and a use is dominated by its
+    // definition, so replacing the result of a dropped load is a single
+    // array write that every later use sees.
+    std::vector<IROperand> replacements(tempEnd - tempBegin);
+    auto replace = [&](IROperand operand) {
+        if (operand.kind == IROperandKind::Temp && operand.value >= tempBegin && operand.value < tempEnd
+            && !replacements[operand.value - tempBegin].isNone()) {
+            return replacements[operand.value - tempBegin];
+        }
+        return operand;
+    };
+
+    std::vector<std::vector<IROperand>> definitions(count);
+    std::vector<IROperand> entryValues(count);
+    std::vector<IRInstruction> entryLoads;
+    auto reaching = [&](uint32_t v) {
+        if (!definitions[v].empty()) {
+            return definitions[v].back();
+        }
+        if (entryValues[v].isNone()) {
+            entryValues[v] = IROperand::temp(nextTemp++);
+            entryLoads.push_back(copy(entryValues[v], IROperand::variable(locals[v]), types[v]));
+        }
+        return entryValues[v];
+    };
+
+    std::vector<std::vector<IRInstruction>> bodies(blockCount);
+    std::vector<uint32_t> pushed;
+    // Blocks to enter, and on the way back out how many definitions to pop
+    std::vector<std::pair<BlockId, uint32_t>> walk{{function.entry(), NoIndex}};
+    while (!walk.empty()) {
+        auto [b, mark] = walk.back();
+        walk.pop_back();
+        if (mark != NoIndex) {
+            while (pushed.size() > mark) {
+                definitions[pushed.back()].pop_back();
+                pushed.pop_back();
+            }
+            continue;
+        }
+        walk.emplace_back(b, static_cast<uint32_t>(pushed.size()));
+
+        for (size_t k = 0; k < phis[b].size(); k++) {
+            uint32_t v = phiVariables[b][k];
+            definitions[v].push_back(phis[b][k].dest());
+            pushed.push_back(v);
+        }
+        for (uint32_t i = function.getBlock(b).begin; i < function.getBlock(b).end; i++) {
+            IRInstruction instruction = instructions[i];
+            uint32_t v;
+            if (instruction.type == IRInstructionType::STORE && (v = promotedIndex(instruction.dest())) != NoIndex) {
+                definitions[v].push_back(replace(instruction.src1()));
+                pushed.push_back(v);
+                continue;
+            }
+            if (instruction.type == IRInstructionType::LOAD && (v = promotedIndex(instruction.src1())) != NoIndex) {
+                replacements[instruction.dest().value - tempBegin] = reaching(v);
+                continue;
+            }
+            instruction.setOperand(1, replace(instruction.src1()));
+            instruction.setOperand(2, replace(instruction.src2()));
+            bodies[b].push_back(instruction);
+        }
+
+        for (BlockId successor : function.getBlock(b).successors) {
+            const std::vector<BlockId>& predecessors = function.getBlock(successor).predecessors;
+            size_t edge = std::find(predecessors.begin(), predecessors.end(), b) - predecessors.begin();
+            for (size_t k = 0; k < phis[successor].size(); k++) {
+                function.phiIncoming(phis[successor][k])[edge] = reaching(phiVariables[successor][k]);
+            }
+        }
+
+        for (BlockId child : dominators.getChildren(b)) {
+            walk.emplace_back(child, NoIndex);
+        }
+    }
+
+    // Unreachable blocks are left as they were
+    std::vector<IRInstruction> rewritten;
+    std::vector<uint32_t> blockEnds(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        rewritten.insert(rewritten.end(), phis[b].begin(), phis[b].end());
+        if (b == function.entry()) {
+            rewritten.insert(rewritten.end(), entryLoads.begin(), entryLoads.end());
+        }
+        if (dominators.isReachable(b)) {
+            rewritten.insert(rewritten.end(), bodies[b].begin(), bodies[b].end());
+        } else {
+            rewritten.insert(rewritten.end(), instructions.begin() + function.getBlock(b).begin,
+                             instructions.begin() + function.getBlock(b).end);
+        }
+        blockEnds[b] = static_cast<uint32_t>(rewritten.size());
+    }
+    function.replaceInstructions(std::move(rewritten), blockEnds);
+}
+
+void destroySSA(IRFunction& function, uint32_t& nextTemp) {
+    const std::vector<IRInstruction>& instructions = function.getInstructions();
+    bool hasPhis = std::any_of(instructions.begin(), instructions.end(),
+                               [](const IRInstruction& instruction) { return instruction.type == IRInstructionType::PHI; });
+    if (!hasPhis) return;
+
+    size_t blockCount = function.getBlockCount();
+    std::vector<std::vector<IRInstruction>> bodies(blockCount);
+    std::vector<std::vector<IRInstruction>> exitCopies(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        const BasicBlock& block = function.getBlock(b);
+        for (uint32_t i = block.begin; i < block.end; i++) {
+            const IRInstruction& instruction = instructions[i];
+            if (instruction.type != IRInstructionType::PHI) {
+                bodies[b].push_back(instruction);
+                continue;
+            }
+            IROperand staging = IROperand::temp(nextTemp++);
+            const IROperand* incoming = function.phiIncoming(instruction);
+            for (size_t k = 0; k < block.predecessors.size(); k++) {
+                // Edges from unreachable blocks were never filled in
+                if (!incoming[k].isNone()) {
+                    exitCopies[block.predecessors[k]].push_back(copy(staging, incoming[k], instruction.valueType));
+                }
+            }
+            bodies[b].push_back(copy(instruction.dest(), staging, instruction.valueType));
+        }
+    }
+
+    std::vector<IRInstruction> rewritten;
+    std::vector<uint32_t> blockEnds(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        std::vector<IRInstruction>& body = bodies[b];
+        bool terminated = !body.empty() && isTerminator(body.back().type);
+        rewritten.insert(rewritten.end(), body.begin(), terminated ? body.end() - 1 : body.end());
+        rewritten.insert(rewritten.end(), exitCopies[b].begin(), exitCopies[b].end());
+        if (terminated) {
+            rewritten.push_back(body.back());
+        }
+        blockEnds[b] = static_cast<uint32_t>(rewritten.size());
+    }
+    function.replaceInstructions(std::move(rewritten), blockEnds);
+    function.clearPhiOperands();
+}
@@ -0,0 +1,201 @@
+#include "valueNumbering.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+
+constexpr uint32_t NoIndex = UINT32_MAX;
+
+// Opcode, type and operands of a computation
+struct Expression {
+    IRInstructionType type;
+    IRType valueType;
+    IROperand left;
+    IROperand right;
+
+    bool operator==(const Expression& other) const {
+        return type == other.type && valueType == other.valueType && left == other.left && right == other.right;
+    }
+};
+
+struct ExpressionHash {
+    size_t operator()(const Expression& expression) const {
+        uint64_t hash = static_cast<uint64_t>(expression.type) << 8 | static_cast<uint64_t>(expression.valueType);
+        for (IROperand operand : {expression.left, expression.right}) {
+            hash = (hash ^ (static_cast<uint64_t>(operand.kind) << 32 | operand.value)) * 0x9E3779B97F4A7C15ull;
+        }
+        return static_cast<size_t>(hash ^ hash >> 29);
+    }
+};
+
+bool isCommutative(IRInstructionType type) {
+    return type == IRInstructionType::ADD || type == IRInstructionType::MUL;
+}
+
+bool operandLess(IROperand a, IROperand b) {
+    return a.kind != b.kind ? a.kind < b.kind : a.value < b.value;
+}
+
+} // namespace
+
+size_t numberValues(IRFunction& function) {
+    return numberValues(function, DominatorTree(function));
+}
+
+size_t numberValues(IRFunction& function, const DominatorTree& dominators) {
+    size_t blockCount = function.getBlockCount();
+    if (blockCount == 0) return 0;
+
+    std::vector<IRInstruction>& instructions = function.getInstructions();
+    uint32_t tempEnd = 0;
+    for (const auto& instruction : instructions) {
+        if (instruction.dest().kind == IROperandKind::Temp && instruction.type != IRInstructionType::BR) {
+            tempEnd = std::max(tempEnd, instruction.dest().value + 1);
+        }
+    }
+
+    // Only temporaries assigned once can stand for a value, and only
+    // variables never stored hold the same value everywhere
+    std::vector<uint8_t> assignments(tempEnd, 0);
+    std::unordered_set<uint32_t> storedVariables;
+    for (const auto& instruction : instructions) {
+        if (instruction.type == IRInstructionType::STORE && instruction.dest().kind == IROperandKind::Variable) {
+            storedVariables.insert(instruction.dest().value);
+        } else if (instruction.dest().kind == IROperandKind::Temp && instruction.type != IRInstructionType::BR) {
+            uint8_t& count = assignments[instruction.dest().value];
+            count = static_cast<uint8_t>(std::min(count + 1, 2));
+        }
+    }
+    auto isValue = [&](IROperand operand) {
+        return operand.kind != IROperandKind::Temp || (operand.value < tempEnd && assignments[operand.value] == 1);
+    };
+
+    std::vector<IROperand> replacements(tempEnd);
+    auto replace = [&](IROperand operand) {
+        while (operand.kind == IROperandKind::Temp && operand.value < tempEnd && !replacements[operand.value].isNone()) {
+            operand = replacements[operand.value];
+        }
+        return operand;
+    };
+
+    std::unordered_map<Expression, IROperand, ExpressionHash> available;
+    std::vector<Expression> scoped;
+    std::unordered_map<uint32_t, IROperand> blockVariables;
+    std::vector<bool> removed(instructions.size(), false);
+    size_t replaced = 0;
+
+    // Blocks are entered in preorder, the marker on the second visit
+    // says how much of the table to drop again
+    std::vector<std::pair<BlockId, uint32_t>> walk{{function.entry(), NoIndex}};
+    while (!walk.empty()) {
+        BlockId b = walk.back().first;
+        uint32_t marker = walk.back().second;
+        walk.pop_back();
+        if (marker != NoIndex) {
+            while (scoped.size() > marker) {
+                available.erase(scoped.back());
+                scoped.pop_back();
+            }
+            continue;
+        }
+        walk.emplace_back(b, static_cast<uint32_t>(scoped.size()));
+
+        const BasicBlock& block = function.getBlock(b);
+        blockVariables.clear();
+        for (uint32_t i = block.begin; i < block.end; i++) {
+            IRInstruction& instruction = instructions[i];
+            if (instruction.type == IRInstructionType::PHI) {
+                IROperand* incoming = function.phiIncoming(instruction);
+                IROperand same;
+                bool trivial = isValue(instruction.dest());
+                for (size_t k = 0; k < block.predecessors.size() && trivial; k++) {
+                    IROperand value = replace(incoming[k]);
+                    if (value.isNone() || value == instruction.dest()) continue;
+                    trivial = same.isNone() || same == value;
+                    same = value;
+                }
+                if (trivial && !same.isNone()) {
+                    replacements[instruction.dest().value] = same;
+                    removed[i] = true;
+                    replaced++;
+                }
+                continue;
+            }
+            instruction.setOperand(1, replace(instruction.src1()));
+            instruction.setOperand(2, replace(instruction.src2()));
+
+            IROperand dest = instruction.dest();
+            IROperand src1 = instruction.src1();
+            if (instruction.type == IRInstructionType::STORE) {
+                if (dest.kind == IROperandKind::Variable) blockVariables[dest.value] = src1;
+                continue;
+            }
+            bool computes = instruction.type == IRInstructionType::ADD || instruction.type == IRInstructionType::SUB
+                || instruction.type == IRInstructionType::MUL || instruction.type == IRInstructionType::DIV
+                || instruction.type == IRInstructionType::ZEXT || instruction.type == IRInstructionType::LOAD;
+            if (!computes || dest.kind != IROperandKind::Temp || !isValue(dest)) continue;
+
+            IROperand found;
+            if (instruction.type == IRInstructionType::LOAD && src1.kind == IROperandKind::Temp) {
+                // Copy
+                found = isValue(src1) ? src1 : IROperand();
+            } else if (instruction.type == IRInstructionType::LOAD && src1.kind == IROperandKind::Variable
+                       && storedVariables.count(src1.value)) {
+                auto it = blockVariables.find(src1.value);
+                if (it != blockVariables.end() && isValue(it->second)) {
+                    found = it->second;
+                } else {
+                    blockVariables[src1.value] = dest;
+                }
+            } else if (isValue(src1) && isValue(instruction.src2())) {
+                Expression expression{instruction.type, instruction.valueType, src1, instruction.src2()};
+                if (isCommutative(expression.type) && operandLess(expression.right, expression.left)) {
+                    std::swap(expression.left, expression.right);
+                }
+                auto inserted = available.emplace(expression, dest);
+                if (inserted.second) {
+                    scoped.push_back(expression);
+                } else {
+                    found = inserted.first->second;
+                }
+            }
+            if (!found.isNone()) {
+                replacements[dest.value] = found;
+                removed[i] = true;
+                replaced++;
+            }
+        }
+
+        for (BlockId child : dominators.getChildren(b)) {
+            walk.emplace_back(child, NoIndex);
+        }
+    }
+    if (replaced == 0) return 0;
+
+    // Phis read values from blocks visited after them, so they are only
+    // rewritten at the end, and so is anything outside the tree
+    std::vector<IRInstruction> rewritten;
+    std::vector<uint32_t> blockEnds(blockCount);
+    for (BlockId b = 0; b < blockCount; b++) {
+        const BasicBlock& block = function.getBlock(b);
+        for (uint32_t i = block.begin; i < block.end; i++) {
+            if (removed[i]) continue;
+            IRInstruction instruction = instructions[i];
+            if (instruction.type == IRInstructionType::PHI) {
+                IROperand* incoming = function.phiIncoming(instruction);
+                for (size_t k = 0; k < block.predecessors.size(); k++) {
+                    incoming[k] = replace(incoming[k]);
+                }
+            } else {
+                instruction.setOperand(1, replace(instruction.src1()));
+                instruction.setOperand(2, replace(instruction.src2()));
+            }
+            rewritten.push_back(instruction);
+        }
+        blockEnds[b] = static_cast<uint32_t>(rewritten.size());
+    }
+    function.replaceInstructions(std::move(rewritten), blockEnds);
+    return replaced;
+}
@@ -0,0 +1,151 @@
+#include "incrementalParser.h"
+#include "parser.h"
+#include <algorithm>
+
+// Replaced subtrees stay in the arena until the next full parse, which
+// happens once they outweigh the live tree
+static constexpr size_t compactionSlack = 1024 * 1024;
+
+static bool isFunction(ASTNodePtr node) {
+    return node->getNodeType() == ASTNodeType::FunctionDeclaration;
+}
+
+ModuleNode* IncrementalParser::update(std::string_view text) {
+    size_t limit = std::min(source.size(), text.size());
+    size_t prefix = std::mismatch(source.begin(), source.begin() + limit, text.begin()).first - source.begin();
+    size_t suffix = std::mismatch(source.rbegin(), source.rbegin() + (limit - prefix), text.rbegin()).first - source.rbegin();
+
+    if (module && prefix == source.size() && source.size() == text.size()) {
+        dirty.clear();
+        topLevelChanged = false;
+        return module;
+    }
+    return reparse(prefix, source.size() - suffix, text);
+}
+
+ModuleNode* IncrementalParser::edit(size_t offset, size_t length, std::string_view replacement) {
+    std::string text = source.substr(0, offset);
+    text.append(replacement);
+    text.append(source, offset + length, std::string::npos);
+    return reparse(offset, offset + length, text);
+}
+
+size_t IncrementalParser::getFunctionCount() const {
+    return std::count_if(items.begin(), items.end(), [](const Item& item) { return isFunction(item.node); });
+}
+
+// Bytes [prefix, oldChangeEnd) of the old source were replaced. Only
+// functions are reused, since a let can still grow if the tokens after it
+// change, while nothing continues past a function's closing brace.
+ModuleNode* IncrementalParser::reparse(size_t prefix, size_t oldChangeEnd, std::string_view text) {
+    size_t oldSize = source.size();
+    if (!module || arena.bytesAllocated() > 2 * liveBytes + compactionSlack) {
+        source.assign(text.data(), text.size());
+        return parseAll();
+    }
+
+    // Last function that ends before the edit, with at least one untouched
+    // byte after it, and the first one starting after the edit
+    size_t front = 0;
+    for (size_t i = 0; i < items.size() && items[i].end < prefix; i++) {
+        if (isFunction(items[i].node)) front = i + 1;
+    }
+    size_t back = front;
+    while (back < items.size() && !(isFunction(items[back].node) && items[back].begin > oldChangeEnd)) {
+        back++;
+    }
+
+    source.assign(text.data(), text.size());
+    size_t regionBegin = front ? items[front - 1].end : 0;
+    std::vector<Item> region;
+    try {
+        for (;;) {
+            bool toEnd = back == items.size();
+            size_t regionEnd = toEnd ? source.size() : items[back].begin + source.size() - oldSize;
+            region.clear();
+            if (parseRegion(regionBegin, regionEnd, !toEnd, region)) break;
+
+            // A comment or word runs into the next function, take it in too
+            do back++; while (back < items.size() && !isFunction(items[back].node));
+        }
+    } catch (const std::exception&) {
+        // The region may just be cut in the wrong place, let the full
+        // parse decide whether this really is an error
+        return parseAll();
+    }
+
+    std::vector<Item> spliced;
+    spliced.reserve(front + region.size() + items.size() - back);
+    spliced.insert(spliced.end(), items.begin(), items.begin() + front);
+    dirty.clear();
+    topLevelChanged = false;
+    for (size_t i = front; i < back; i++) {
+        topLevelChanged |= !isFunction(items[i].node);
+    }
+    for (const auto& item : region) {
+        if (isFunction(item.node)) dirty.push_back(static_cast<FunctionNode*>(item.node));
+        topLevelChanged |= !isFunction(item.node);
+        spliced.push_back(item);
+    }
+    for (size_t i = back; i < items.size(); i++) {
+        spliced.push_back(Item{items[i].begin + source.size() - oldSize, items[i].end + source.size() - oldSize, items[i].node});
+    }
+    items.swap(spliced);
+
+    return finish();
+}
+
+ModuleNode* IncrementalParser::parseAll() {
+    items.clear();
+    dirty.clear();
+    topLevelChanged = true;
+    module = nullptr;
+    arena = ASTArena();
+
+    parseRegion(0, source.size(), false, items);
+    for (const auto& item : items) {
+        if (isFunction(item.node)) dirty.push_back(static_cast<FunctionNode*>(item.node));
+    }
+    finish();
+    liveBytes = arena.bytesAllocated();
+    return module;
+}
+
+// Lexes and parses source[begin, end) into top-level items. In partial
+// mode the region has to end on a clean token boundary outside of any
+// comment, otherwise nothing is parsed and false is returned.
+bool IncrementalParser::parseRegion(size_t begin, size_t end, bool partial, std::vector<Item>& out) {
+    std::string_view text(source.data() + begin, end - begin);
+    Lexer lexer(text, StringInterner::global(), partial, false);
+    std::vector<Token> tokens;
+    Token token;
+    while (lexer.next(token)) {
+        tokens.push_back(token);
+    }
+    if (partial && (lexer.isInsideComment() || lexer.consumed() != text.size())) {
+        return false;
+    }
+
+    Parser parser(tokens, arena);
+    for (;;) {
+        const Token* first = parser.position();
+        ASTNodePtr node = parser.parseItem();
+        if (!node) break;
+
+        const Token* last = parser.position() - 1;
+        size_t itemBegin = first->value.data() - source.data();
+        size_t itemEnd = last->value.data() + last->value.size() - source.data();
+        out.push_back(Item{itemBegin, itemEnd, node});
+    }
+    return true;
+}
+
+ModuleNode* IncrementalParser::finish() {
+    std::vector<ASTNodePtr> nodes;
+    nodes.reserve(items.size());
+    for (const auto& item : items) {
+        nodes.push_back(item.node);
+    }
+    module = arena.make<ModuleNode>(ASTNodeList(arena.copyArray(nodes.data(), nodes.size()), nodes.size()));
+    return module;
+}
@@ -1,11 +1,141 @@
 #include "parser.h"
+#include "threadPool.h"
+#include <charconv>
+#include <exception>
 #include <stdexcept>
 #include <iostream>
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+Parser::Parser(const std::vector<Token>& tokens, ASTArena& arena)
+    : Parser(tokens.data(), tokens.data() + tokens.size(), arena) {}
+
+Parser::Parser(const Token* begin, const Token* end, ASTArena& arena)
+    : arena(arena), windowBegin(begin), cursor(begin), windowEnd(end) {}
+
+Parser::Parser(TokenStream& stream, ASTArena& arena) : arena(arena), stream(&stream) {}
 
 ASTNodePtr Parser::parse() {
-    return parseExpression();
+    size_t start = scratch.size();
+    parseItems();
+    return arena.make<ModuleNode>(finishList(start));
+}
+
+ASTNodePtr Parser::parseItem() {
+    return peek().type == TokenType::End ? nullptr : parseExpression();
+}
+
+// Collects top-level items until the end of the current input
+void Parser::parseItems() {
+    while (ASTNodePtr item = parseItem()) {
+        scratch.push_back(item);
+    }
+}
+
+struct FunctionRegion {
+    const Token* begin;
+    const Token* end;
+};
+
+// Tokens after which a new top-level item has to start, anything else
+// (an operator, '=', 'let', ...) could take a following def as operand
+static bool endsItem(TokenType type) {
+    return type == TokenType::Number || type == TokenType::Identifier || type == TokenType::BooleanLiteral
+        || type == TokenType::ClosedParen || type == TokenType::ClosedBracket;
+}
+
+// Finds the top-level 'def ... { ... }' spans. Returns nothing if the
+// braces do not balance, the serial parser then reports the error.
+static std::vector<FunctionRegion> findFunctionRegions(const Token* begin, const Token* end) {
+    std::vector<FunctionRegion> regions;
+    int parens = 0;
+    for (const Token* token = begin; token < end; token++) {
+        if (token->type == TokenType::OpenParen) parens++;
+        if (token->type == TokenType::ClosedParen) parens--;
+
+        bool topLevel = parens == 0 && (token == begin || endsItem(token[-1].type));
+        if (token->type != TokenType::Keyword || token->value != "def" || !topLevel) continue;
+
+        const Token* close = token + 1;
+        while (close < end && close->type != TokenType::OpenBracket) close++;
+        int depth = 0;
+        for (; close < end; close++) {
+            if (close->type == TokenType::OpenBracket) depth++;
+            if (close->type == TokenType::ClosedBracket && --depth == 0) break;
+        }
+        if (close == end) return {};
+
+        regions.push_back(FunctionRegion{token, close + 1});
+        token = close;
+    }
+    return regions;
+}
+
+ASTNodePtr Parser::parse(ThreadPool& pool) {
+    if (stream || pool.size() == 1) {
+        return parse();
+    }
+
+    std::vector<FunctionRegion> regions = findFunctionRegions(cursor, windowEnd);
+    if (regions.size() < 2) {
+        return parse();
+    }
+
+    std::vector<ASTArena> arenas(pool.size());
+    std::vector<ASTNodePtr> functions(regions.size());
+    std::vector<std::exception_ptr> errors(regions.size());
+    pool.parallelFor(regions.size(), [&](size_t i, unsigned worker) {
+        try {
+            Parser parser(regions[i].begin, regions[i].end, arenas[worker]);
+            parser.setLazyBodies(lazyBodies);
+            functions[i] = parser.parseExpression();
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (auto& workerArena : arenas) {
+        arena.adopt(std::move(workerArena));
+    }
+
+    // Stitch the functions together with the items between them, errors
+    // are raised in source order just like the serial parser would
+    size_t start = scratch.size();
+    const Token* end = windowEnd;
+    for (size_t i = 0; i < regions.size(); i++) {
+        windowEnd = regions[i].begin;
+        parseItems();
+
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+        scratch.push_back(functions[i]);
+        windowBegin = cursor = regions[i].end;
+    }
+    windowEnd = end;
+    parseItems();
+
+    return arena.make<ModuleNode>(finishList(start));
+}
+
+// Function body up to and including the closing brace
+ASTNodeList Parser::parseBody() {
+    size_t start = scratch.size();
+    while (!match(TokenType::ClosedBracket)) {
+        ASTNodePtr bodyNode = parseExpression();
+        scratch.push_back(bodyNode);
+    }
+    if (scratch.size() == start) {
+        throw std::runtime_error("Expected function body");
+    }
+    return finishList(start);
+}
+
+ASTNodeList LazyBodyParser::parseBody(const Token* begin, const Token* end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Include the closing brace so the body ends the way it does eagerly
+    Parser parser(begin, end + 1, arena);
+    parser.setLazyBodies(this);
+    ASTNodeList body = parser.parseBody();
+    parsedCount++;
+    return body;
 }
 
 bool Parser::match(TokenType type) {
@@ -16,15 +146,43 @@ bool Parser::match(TokenType type) {
     return false;
 }
 
-const Token Parser::peek() const {
-    if (current < tokens.size()) {return tokens[current];}
+const Token& Parser::peek() {
+    static const Token endToken{"", TokenType::End};
+    if (cursor == windowEnd && !refill()) {return endToken;}
+    return *cursor;
+}
 
-    Token endToken = Token{"", TokenType::End};
-    return endToken;
+const Token& Parser::previous() const {
+    return cursor != windowBegin ? cursor[-1] : lastToken;
 }
 
 void Parser::advance() {
-    if (current < tokens.size()) {current++;}
+    if (cursor != windowEnd || refill()) {cursor++;}
+}
+
+bool Parser::refill() {
+    if (!stream) {return false;}
+
+    if (cursor != windowBegin) {
+        lastToken = cursor[-1];
+    }
+    const Token* begin;
+    const Token* end;
+    if (!stream->nextWindow(begin, end)) {
+        stream = nullptr;
+        return false;
+    }
+    windowBegin = cursor = begin;
+    windowEnd = end;
+    return true;
+}
+
+// Moves the nodes collected since start into the arena
+ASTNodeList Parser::finishList(size_t start) {
+    size_t count = scratch.size() - start;
+    ASTNodeList list(arena.copyArray(scratch.data() + start, count), static_cast<uint32_t>(count));
+    scratch.resize(start);
+    return list;
 }
 
 ASTNodePtr Parser::parseExpression() {
@@ -34,17 +192,17 @@ ASTNodePtr Parser::parseExpression() {
             throw std::runtime_error("Expected '='");
         }
         auto value = parseExpression();
-        return std::make_shared<LetNode>(identifier, value);
+        return arena.make<LetNode>(identifier, value);
     }
-    else if (match(TokenType::Keyword) && tokens[current-1].value == "def") {
+    else if (match(TokenType::Keyword) && previous().value == "def") {
         // Start of function
         if (!match(TokenType::Identifier)) {
             throw std::runtime_error("Expected function name");
         }
-        std::string name = tokens[current-1].value;
+        SymbolId name = previous().symbol;
 
         // Handle function arguments
-        std::vector<ASTNodePtr> params;
+        size_t start = scratch.size();
         if (!match(TokenType::OpenParen)) {
             throw std::runtime_error("Expected '('");
         }
@@ -52,52 +210,113 @@ ASTNodePtr Parser::parseExpression() {
             if (!match(TokenType::Identifier)) {
                 throw std::runtime_error("Expected parameter name");
             }
-            params.push_back(std::make_shared<IdentifierNode>(tokens[current-1].value));
+            scratch.push_back(arena.make<IdentifierNode>(previous().symbol));
         }
+        ASTNodeList params = finishList(start);
 
         // Handle function body
-        std::vector<ASTNodePtr> bodyNodes;
         if (!match(TokenType::OpenBracket)) {
             throw std::runtime_error("Expected '{'");
         }
-        while (!match(TokenType::ClosedBracket)) {
-            bodyNodes.push_back(parseExpression());
-        }
-        if (bodyNodes.empty()) {
-            throw std::runtime_error("Expected function body");
+        if (lazyBodies && !stream) {
+            // Skip to the matching brace, the body is parsed on demand
+            const Token* bodyBegin = cursor;
+            int depth = 1;
+            for (; cursor < windowEnd; cursor++) {
+                if (cursor->type == TokenType::OpenBracket) depth++;
+                if (cursor->type == TokenType::ClosedBracket && --depth == 0) break;
+            }
+            if (cursor == windowEnd) {
+                throw std::runtime_error("Expected '}'");
+            }
+            const Token* bodyEnd = cursor++;
+            return arena.make<FunctionNode>(name, params, lazyBodies, bodyBegin, bodyEnd);
         }
-        return std::make_shared<FunctionNode>(name, params, bodyNodes);
+        return arena.make<FunctionNode>(name, params, parseBody());
     }
 
-    return parseTerm();
+    return parseBinaryExpression();
 }
 
-ASTNodePtr Parser::parseTerm() {
-    auto node = parseFactor();
-    if(match(TokenType::Add) || match(TokenType::Subtract) || match(TokenType::Multiply) || match(TokenType::Divide)) {
-        auto op = tokens[current-1].type;
-        auto right = parseTerm();
-        node = std::make_shared<BinaryOperatorNode>(op, node, right);
+// Binding power of binary operators, 0 for tokens that end an expression
+static int precedence(TokenType type) {
+    switch (type) {
+        case TokenType::Equals:
+            return 1;
+        case TokenType::Add:
+        case TokenType::Subtract:
+            return 2;
+        case TokenType::Multiply:
+        case TokenType::Divide:
+            return 3;
+        default:
+            return 0;
     }
-    else if (match(TokenType::Equals)) {
-        auto right = parseExpression();
-        node = std::make_shared<EqualsNode>(node, right);
+}
+
+// Assignment is the only right associative operator
+static bool isRightAssociative(TokenType type) {
+    return type == TokenType::Equals;
+}
+
+void Parser::reduce() {
+    TokenType op = operators.back();
+    operators.pop_back();
+    ASTNodePtr right = operands.back();
+    operands.pop_back();
+    ASTNodePtr left = operands.back();
+
+    if (op == TokenType::Equals) {
+        operands.back() = arena.make<EqualsNode>(left, right);
+    } else {
+        operands.back() = arena.make<BinaryOperatorNode>(op, left, right);
     }
+}
 
+// Operator precedence parsing with explicit stacks, so operator chains of
+// any length are parsed in one loop. Only parentheses recurse.
+ASTNodePtr Parser::parseBinaryExpression() {
+    size_t operatorBase = operators.size();
+    operands.push_back(parseFactor());
+
+    while (int prec = precedence(peek().type)) {
+        TokenType op = peek().type;
+        advance();
+
+        while (operators.size() > operatorBase) {
+            int topPrec = precedence(operators.back());
+            if (topPrec < prec || (topPrec == prec && isRightAssociative(op))) break;
+            reduce();
+        }
+        operators.push_back(op);
+        operands.push_back(parseFactor());
+    }
+
+    while (operators.size() > operatorBase) {
+        reduce();
+    }
+
+    ASTNodePtr node = operands.back();
+    operands.pop_back();
     return node;
 }
 
 ASTNodePtr Parser::parseFactor() {
     if(match(TokenType::Number)){
-        int value = std::stoi(tokens[current-1].value);
-        return std::make_shared<NumberNode>(value);
+        std::string_view text = previous().value;
+        int value;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc()) {
+            throw std::runtime_error("Number out of range " + std::string(text));
+        }
+        return arena.make<NumberNode>(value);
     }
     else if (match(TokenType::Identifier)) {
-        return std::make_shared<IdentifierNode>(tokens[current-1].value);
+        return arena.make<IdentifierNode>(previous().symbol);
     }
     else if (match(TokenType::BooleanLiteral)) {
-        bool value = tokens[current-1].value == "True";
-        return std::make_shared<BooleanLiteralNode>(value);
+        bool value = previous().value == "True";
+        return arena.make<BooleanLiteralNode>(value);
     }
     else if (match(TokenType::OpenParen)) {
         ASTNodePtr node = parseExpression();
@@ -107,6 +326,6 @@ ASTNodePtr Parser::parseFactor() {
         return node;
     }
     else {
-        throw std::runtime_error("Unexpected token " + tokens[current].value);
+        throw std::runtime_error("Unexpected token " + std::string(peek().value));
     }
 }
\ No newline at end of file
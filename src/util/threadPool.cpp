@@ -0,0 +1,86 @@
+#include "threadPool.h"
+
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+    }
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t index, unsigned worker)>& task) {
+    if (workers.empty() || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        taskCount = count;
+        nextIndex = 0;
+        activeWorkers = static_cast<unsigned>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return activeWorkers == 0; });
+    this->task = nullptr;
+
+    if (failure) {
+        std::exception_ptr error = failure;
+        failure = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop(unsigned worker) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        runTasks(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runTasks(unsigned worker) {
+    size_t index;
+    while ((index = nextIndex.fetch_add(1)) < taskCount) {
+        try {
+            (*task)(index, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure) failure = std::current_exception();
+            nextIndex = taskCount;
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include "astArena.h"
+#include "astVisitor.h"
+#include "staticVisitor.h"
+
+// Per-node cost of the two ways passes reach a node's handler: the
+// virtual accept()/visit() pair plus dynamic_cast probing, against the
+// switch in StaticASTVisitor plus nodeCast on the type tag.
+
+struct Counts {
+    uint64_t numbers = 0;
+    uint64_t identifiers = 0;
+    uint64_t binaries = 0;
+    uint64_t other = 0;
+
+    uint64_t sum() const { return numbers * 3 + identifiers * 5 + binaries * 7 + other * 11; }
+};
+
+class VirtualCounter : public ASTVisitor {
+public:
+    Counts counts;
+
+    void visit(NumberNode& node) override { counts.numbers += node.getValue() != 0; }
+    void visit(IdentifierNode& node) override { counts.identifiers += node.getSymbol() != 0; }
+    void visit(BinaryOperatorNode& node) override { counts.binaries++; }
+    void visit(EqualsNode& node) override { counts.other++; }
+    void visit(LetNode& node) override { counts.other++; }
+    void visit(FunctionNode& node) override { counts.other++; }
+    void visit(BooleanLiteralNode& node) override { counts.other += node.getValue(); }
+    void visit(ModuleNode& node) override { counts.other++; }
+};
+
+class StaticCounter final : public StaticASTVisitor<StaticCounter> {
+public:
+    Counts counts;
+
+    void visit(NumberNode& node) { counts.numbers += node.getValue() != 0; }
+    void visit(IdentifierNode& node) { counts.identifiers += node.getSymbol() != 0; }
+    void visit(BinaryOperatorNode& node) { counts.binaries++; }
+    void visit(EqualsNode& node) { counts.other++; }
+    void visit(LetNode& node) { counts.other++; }
+    void visit(FunctionNode& node) { counts.other++; }
+    void visit(BooleanLiteralNode& node) { counts.other += node.getValue(); }
+    void visit(ModuleNode& node) { counts.other++; }
+};
+
+// The cast ladder IRGenerator::handleLiteral used to run per operand
+static Counts probeDynamic(const std::vector<ASTNodePtr>& nodes) {
+    Counts counts;
+    for (ASTNodePtr node : nodes) {
+        if (auto number = dynamic_cast<NumberNode*>(node)) {
+            counts.numbers += number->getValue() != 0;
+        } else if (auto boolean = dynamic_cast<BooleanLiteralNode*>(node)) {
+            counts.other += boolean->getValue();
+        } else if (auto identifier = dynamic_cast<IdentifierNode*>(node)) {
+            counts.identifiers += identifier->getSymbol() != 0;
+        } else if (dynamic_cast<BinaryOperatorNode*>(node)) {
+            counts.binaries++;
+        } else {
+            counts.other++;
+        }
+    }
+    return counts;
+}
+
+static Counts probeTagged(const std::vector<ASTNodePtr>& nodes) {
+    Counts counts;
+    for (ASTNodePtr node : nodes) {
+        if (auto number = nodeCast<NumberNode>(node)) {
+            counts.numbers += number->getValue() != 0;
+        } else if (auto boolean = nodeCast<BooleanLiteralNode>(node)) {
+            counts.other += boolean->getValue();
+        } else if (auto identifier = nodeCast<IdentifierNode>(node)) {
+            counts.identifiers += identifier->getSymbol() != 0;
+        } else if (nodeCast<BinaryOperatorNode>(node)) {
+            counts.binaries++;
+        } else {
+            counts.other++;
+        }
+    }
+    return counts;
+}
+
+template <typename Fn>
+static double nanosPerNode(size_t nodes, int rounds, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        fn();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(nodes) * rounds);
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    int rounds = 20;
+
+    // A shuffled mix of the node types expressions are made of, so the
+    // dispatch branch cannot be predicted from the previous node
+    ASTArena arena;
+    std::vector<ASTNodePtr> nodes;
+    nodes.reserve(count);
+    ASTNodePtr leaf = arena.make<NumberNode>(1);
+    for (size_t i = 0; i < count; i++) {
+        switch (i % 6) {
+            case 0: case 1: nodes.push_back(arena.make<NumberNode>(static_cast<int>(i))); break;
+            case 2: case 3: nodes.push_back(arena.make<IdentifierNode>(static_cast<SymbolId>(i))); break;
+            case 4: nodes.push_back(arena.make<BinaryOperatorNode>(TokenType::Add, leaf, leaf)); break;
+            case 5: nodes.push_back(arena.make<LetNode>(leaf, leaf)); break;
+        }
+    }
+    std::shuffle(nodes.begin(), nodes.end(), std::mt19937(1));
+
+    uint64_t sink = 0;
+    VirtualCounter virtualCounter;
+    StaticCounter staticCounter;
+    double virtualNs = nanosPerNode(count, rounds, [&] {
+        for (ASTNodePtr node : nodes) node->accept(virtualCounter);
+    });
+    double staticNs = nanosPerNode(count, rounds, [&] {
+        for (ASTNodePtr node : nodes) staticCounter.dispatch(*node);
+    });
+    double dynamicNs = nanosPerNode(count, rounds, [&] { sink += probeDynamic(nodes).sum(); });
+    double taggedNs = nanosPerNode(count, rounds, [&] { sink += probeTagged(nodes).sum(); });
+
+    if (virtualCounter.counts.sum() != staticCounter.counts.sum()) {
+        std::cerr << "Dispatchers disagree" << std::endl;
+        return 1;
+    }
+
+    std::cout << count << " nodes, " << rounds << " rounds" << std::endl;
+    std::cout << "accept()/visit() virtual dispatch: " << virtualNs << " ns/node" << std::endl;
+    std::cout << "StaticASTVisitor::dispatch:        " << staticNs << " ns/node" << std::endl;
+    std::cout << "dynamic_cast ladder:               " << dynamicNs << " ns/node" << std::endl;
+    std::cout << "nodeCast ladder:                   " << taggedNs << " ns/node" << std::endl;
+    std::cout << "(checksum " << sink << ")" << std::endl;
+    return 0;
+}
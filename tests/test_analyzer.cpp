@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include "symbolTable.h"
+#include "parser.h"
+#include "semanticAnalyzer.h"
+#include "irGenerator.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+int main() {
+    StringInterner& interner = StringInterner::global();
+    SymbolId x = interner.intern("x");
+    SymbolId y = interner.intern("y");
+
+    // Inner declarations shadow outer ones until their scope is left
+    {
+        SymbolTable table;
+        table.insert(x, SymbolType::VARIABLE, DataType::Int);
+        table.enterScope();
+        table.insert(x, SymbolType::PARAMETER, DataType::Bool);
+        table.insert(y, SymbolType::VARIABLE, DataType::Int);
+
+        SymbolInfo info;
+        check(table.lookup(x, info) && info.type == SymbolType::PARAMETER && !info.binding.global
+              && info.binding.slot == 0, "Inner x should shadow the global");
+        check(table.lookup(y, info) && info.binding.slot == 1, "Frame slots should be numbered in order");
+
+        table.exitScope();
+        check(table.lookup(x, info) && info.type == SymbolType::VARIABLE && info.binding.global
+              && info.binding.type == DataType::Int, "Leaving the scope should restore the global");
+        check(!table.lookup(y, info), "Leaving the scope should drop its declarations");
+
+        table.enterScope();
+        check(table.insert(y, SymbolType::VARIABLE, DataType::Int).binding.slot == 0, "Each function frame should start at slot 0");
+        table.exitScope();
+    }
+
+    // Redeclaring in the same scope is an error
+    {
+        SymbolTable table;
+        table.insert(x, SymbolType::VARIABLE, DataType::Int);
+        bool threw = false;
+        try {
+            table.insert(x, SymbolType::VARIABLE, DataType::Int);
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(threw, "Redeclaring x should throw");
+    }
+
+    // The table keeps working as it grows
+    {
+        SymbolTable table;
+        for (int i = 0; i < 5000; i++) {
+            table.insert(interner.intern("v" + std::to_string(i)), SymbolType::VARIABLE, DataType::Int);
+        }
+        SymbolInfo info;
+        bool found = true;
+        for (int i = 0; i < 5000; i++) {
+            found = found && table.lookup(interner.intern("v" + std::to_string(i)), info) && info.binding.slot == static_cast<uint32_t>(i);
+        }
+        check(found, "Every declaration should be found with its slot");
+    }
+
+    // Every expression gets a type, and the IR carries it as a width
+    {
+        std::vector<Token> tokens = tokenize("let t = True\nlet n = 2\nlet s = t\nlet m = n * s\n");
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        try {
+            auto module = static_cast<ModuleNode*>(parser.parse());
+            SemanticAnalyzer analyzer;
+            analyzer.analyze(module);
+            auto let = [&](size_t i) { return static_cast<LetNode*>(module->getItems()[i]); };
+            check(let(0)->getIdentifier()->getDataType() == DataType::Bool, "t should be a bool");
+            check(let(2)->getValue()->getDataType() == DataType::Bool
+                  && let(2)->getIdentifier()->getDataType() == DataType::Bool, "s should take the type of t");
+            check(let(3)->getValue()->getDataType() == DataType::Int, "Arithmetic should be an int");
+
+            IRGenerator generator;
+            generator.generateIR(module);
+            const std::vector<IRInstruction>& ir = generator.getFunctions()[0].getInstructions();
+            check(ir[0].type == IRInstructionType::LOAD && ir[0].valueType == IRType::I8, "Bool literals should load a byte");
+            check(ir[5].type == IRInstructionType::STORE && ir[5].valueType == IRType::I8, "Bool variables should store a byte");
+            size_t widened = 0;
+            for (const auto& instruction : ir) {
+                widened += instruction.type == IRInstructionType::ZEXT;
+            }
+            check(widened == 1, "Only the bool operand of the multiplication should be widened");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+    }
+
+    if (failures) {
+        std::cerr << failures << " analyzer test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Analysis successful!" << std::endl;
+    return 0;
+}
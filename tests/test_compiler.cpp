@@ -0,0 +1,155 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "parser.h"
+#include "semanticAnalyzer.h"
+#include "moduleCompiler.h"
+#include "threadPool.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+// Identifiers are letters only, so spell numbers with them
+static std::string letters(int value) {
+    std::string name;
+    do {
+        name += static_cast<char>('a' + value % 26);
+        value /= 26;
+    } while (value);
+    return name;
+}
+
+struct Result {
+    std::vector<uint8_t> code;
+    std::string diagnostics;
+    std::string error;
+};
+
+static Result compile(const std::string& source, unsigned threads) {
+    std::vector<Token> tokens = tokenize(source);
+    ASTArena arena;
+    Parser parser(tokens, arena);
+    ThreadPool pool(threads);
+    ModuleCompiler compiler(pool);
+    std::ostringstream diagnostics;
+    Result result;
+    try {
+        compiler.compile(*static_cast<ModuleNode*>(parser.parse()), diagnostics);
+        result.code = compiler.getCode().getCode();
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    result.diagnostics = diagnostics.str();
+    return result;
+}
+
+// The whole module through one analyzer, one IR generator and one code
+// generator, the way it was compiled before functions went to the pool
+static std::vector<uint8_t> compileSerially(const std::string& source) {
+    std::vector<Token> tokens = tokenize(source);
+    ASTArena arena;
+    Parser parser(tokens, arena);
+    ASTNodePtr module = parser.parse();
+    SemanticAnalyzer analyzer;
+    analyzer.analyze(module);
+    IRGenerator ir(analyzer.getGlobalCount());
+    ir.generateIR(module);
+    PassManager passes = PassManager::forLevel(PassManager::DefaultLevel);
+    PassStatistics stats;
+    CodeGenerator code(ir.getGlobalCount());
+    for (auto& function : ir.getFunctions()) {
+        passes.run(function, ir.getTempCounter(), stats);
+        code.generateCode(function);
+    }
+    return code.getCode();
+}
+
+// Whether code has a MOV with opcode between a register and the absolute
+// address, the way globals are accessed
+static bool accesses(const std::vector<uint8_t>& code, uint8_t opcode, uint32_t address) {
+    for (size_t i = 0; i + 6 <= code.size(); i++) {
+        if (code[i] != opcode || (code[i + 1] & 0xC7) != 0x05) continue;
+        uint32_t target = code[i + 2] | code[i + 3] << 8 | code[i + 4] << 16 | static_cast<uint32_t>(code[i + 5]) << 24;
+        if (target == address) return true;
+    }
+    return false;
+}
+
+int main() {
+    // Every pool size produces the same bytes and diagnostics, and a
+    // function only sees the globals declared before it
+    {
+        std::string source = "let g = 2\nlet t = True\n";
+        for (int i = 0; i < 200; i++) {
+            source += "def f" + letters(i) + "() {\n    let a = g * " + std::to_string(i) + " + t\n    let b = a / 3 - later\n}\n";
+            if (i == 100) source += "let later = 7\n";
+        }
+
+        Result serial = compile(source, 1);
+        check(serial.error.empty(), "Module should compile: " + serial.error);
+        check(!serial.code.empty(), "Module should produce code");
+
+        size_t missing = 0;
+        for (size_t at = 0; (at = serial.diagnostics.find("later not found", at)) != std::string::npos; at++) {
+            missing++;
+        }
+        check(missing == 101, "Functions before the global should not see it");
+
+        for (unsigned threads : {2u, 4u, 8u}) {
+            Result parallel = compile(source, threads);
+            check(parallel.code == serial.code, "Code should not depend on the number of threads");
+            check(parallel.diagnostics == serial.diagnostics, "Diagnostics should come out in source order");
+        }
+    }
+
+    // The first error in source order is the one reported, with only the
+    // diagnostics before it
+    {
+        std::string source;
+        for (int i = 0; i < 50; i++) {
+            source += "def f" + letters(i) + "() {\n    let a = unknown" + letters(i) + "\n";
+            if (i == 20 || i == 30) source += "    let a = 1\n";
+            source += "}\n";
+        }
+        for (unsigned threads : {1u, 4u}) {
+            Result result = compile(source, threads);
+            check(result.error.find("'a' already declared") != std::string::npos, "Redeclaration should be reported");
+            check(result.diagnostics.find("unknownu ") != std::string::npos
+                  && result.diagnostics.find("unknownv ") == std::string::npos,
+                  "Only diagnostics up to the first error should be written");
+        }
+    }
+
+    // A global written by one unit is read from the same place by a later
+    // one, as it is when the module is compiled serially
+    {
+        std::string source = "let g = 7\nlet s = 3\n"
+                             "def f() {\n    let a = 1\n    let b = a * 2 + g\n}\n"
+                             "let h = g + s\n";
+        std::vector<uint8_t> serial = compileSerially(source);
+        for (unsigned threads : {1u, 4u}) {
+            Result result = compile(source, threads);
+            check(result.error.empty(), "Globals module should compile: " + result.error);
+            for (const std::vector<uint8_t>* code : {&serial, &result.code}) {
+                // From a register, or as an immediate once constants are propagated
+                auto stores = [&](uint32_t address) { return accesses(*code, 0x89, address) || accesses(*code, 0xC7, address); };
+                check(stores(0) && stores(4), "Initializers should store g and s in their cells");
+                check(accesses(*code, 0x8B, 0) && accesses(*code, 0x8B, 4), "Later units should load g and s from their cells");
+                check(stores(8), "h should be stored in its own cell");
+            }
+        }
+    }
+
+    if (failures) {
+        std::cerr << failures << " compiler test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Compilation successful!" << std::endl;
+    return 0;
+}
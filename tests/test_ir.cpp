@@ -0,0 +1,455 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "parser.h"
+#include "semanticAnalyzer.h"
+#include "irGenerator.h"
+#include "codeGenerator.h"
+#include "flatAst.h"
+#include "irFile.h"
+#include "dominatorTree.h"
+#include "loopInfo.h"
+#include "ssa.h"
+#include <unistd.h>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+// Fresh file in the temporary directory, removed by the caller
+static std::string temporaryPath() {
+    std::string path = (std::filesystem::temp_directory_path() / "test_ir_XXXXXX").string();
+    close(mkstemp(&path[0]));
+    return path;
+}
+
+static void ret(IRFunction& function) {
+    function.append(IRInstruction(IRInstructionType::RET, IROperand(), IROperand(), IROperand(), IRType::Void));
+}
+
+static void load(IRFunction& function, uint32_t temp, IROperand source) {
+    function.append(IRInstruction(IRInstructionType::LOAD, IROperand::temp(temp), source));
+}
+
+static void store(IRFunction& function, uint32_t variable, uint32_t temp) {
+    function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(variable), IROperand::temp(temp)));
+}
+
+static size_t countOf(const IRFunction& function, IRInstructionType type) {
+    size_t count = 0;
+    for (const auto& instruction : function.getInstructions()) {
+        count += instruction.type == type;
+    }
+    return count;
+}
+
+static bool touchesVariable(const IRFunction& function, uint32_t variable) {
+    for (const auto& instruction : function.getInstructions()) {
+        if ((instruction.type == IRInstructionType::LOAD && instruction.src1() == IROperand::variable(variable))
+            || (instruction.type == IRInstructionType::STORE && instruction.dest() == IROperand::variable(variable))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    IROperand condition = IROperand::temp(0);
+
+    // Diamond: the join is dominated by the entry only
+    {
+        BlockId left = 1;
+        BlockId right = 2;
+        BlockId join = 3;
+        IRFunction function;
+        function.addBlock();
+        function.branch(condition, left, right);
+        function.addBlock();
+        function.jump(join);
+        function.addBlock();
+        function.jump(join);
+        function.addBlock();
+        ret(function);
+        function.buildCFG();
+
+        check(function.getBlock(0).successors.size() == 2 && function.getBlock(join).predecessors.size() == 2,
+              "Branches should become edges");
+        DominatorTree dominators(function);
+        check(dominators.getIdom(0) == NoBlock && dominators.getIdom(left) == 0 && dominators.getIdom(join) == 0,
+              "The join should be dominated by the entry");
+        check(dominators.dominates(0, join) && !dominators.dominates(left, join) && dominators.dominates(join, join),
+              "Dominance should follow the tree");
+        check(dominators.getChildren(0).size() == 3, "Every block should hang off the entry");
+        check(LoopInfo(function, dominators).getLoops().empty(), "A diamond has no loops");
+    }
+
+    // Two nested loops and a block nothing reaches
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        function.jump(1);
+        function.addBlock();           // 1: outer header
+        function.branch(condition, 2, 5);
+        function.addBlock();           // 2: inner header
+        function.branch(condition, 3, 4);
+        function.addBlock();           // 3: inner latch
+        function.jump(2);
+        function.addBlock();           // 4: outer latch
+        function.jump(1);
+        function.addBlock();           // 5: exit
+        ret(function);
+        function.addBlock();           // 6: unreachable
+        function.jump(2);
+        function.buildCFG();
+
+        DominatorTree dominators(function);
+        check(dominators.getIdom(2) == 1 && dominators.getIdom(4) == 2 && dominators.getIdom(5) == 1,
+              "Loop blocks should be dominated by their headers");
+        check(!dominators.isReachable(6) && dominators.getIdom(6) == NoBlock && !dominators.dominates(6, 2),
+              "Unreachable blocks should dominate nothing");
+        check(dominators.getReversePostorder().size() == 6, "Only reachable blocks should be ordered");
+
+        LoopInfo loops(function, dominators);
+        check(loops.getLoops().size() == 2, "Both loops should be found");
+        LoopId outer = loops.getLoopFor(1);
+        LoopId inner = loops.getLoopFor(3);
+        check(outer != NoLoop && inner != NoLoop && loops.getLoop(inner).parent == outer
+              && loops.getLoop(inner).header == 2, "The inner loop should nest in the outer one");
+        check(loops.getLoop(outer).blocks.size() == 4 && loops.getLoop(inner).blocks.size() == 2,
+              "Loops should hold their bodies");
+        check(loops.getLoopDepth(0) == 0 && loops.getLoopDepth(1) == 1 && loops.getLoopDepth(3) == 2
+              && loops.getLoopDepth(4) == 1 && loops.getLoopDepth(5) == 0 && loops.getLoopDepth(6) == 0,
+              "Loop depths should count the enclosing loops");
+    }
+
+    // Blocks in the middle of a function have to end in a terminator
+    {
+        IRFunction function;
+        function.addBlock();
+        function.append(IRInstruction(IRInstructionType::LOAD, IROperand::temp(0), IROperand::immediate(1)));
+        function.addBlock();
+        ret(function);
+        bool threw = false;
+        try {
+            function.buildCFG();
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(threw, "Falling through to the next block should be rejected");
+    }
+
+    // A variable stored on both sides of a diamond needs a phi at the join,
+    // one only read is loaded once at the entry, and non-local ones stay
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        load(function, 0, IROperand::variable(1));
+        function.branch(IROperand::temp(0), 1, 2);
+        function.addBlock();           // 1
+        load(function, 1, IROperand::immediate(1));
+        store(function, 0, 1);
+        store(function, 2, 1);
+        function.jump(3);
+        function.addBlock();           // 2
+        load(function, 2, IROperand::immediate(2));
+        store(function, 0, 2);
+        function.jump(3);
+        function.addBlock();           // 3
+        load(function, 3, IROperand::variable(0));
+        load(function, 4, IROperand::variable(1));
+        function.append(IRInstruction(IRInstructionType::ADD, IROperand::temp(5), IROperand::temp(3), IROperand::temp(4)));
+        store(function, 2, 5);
+        ret(function);
+        function.buildCFG();
+        function.setLocalVariables({0, 1});
+
+        uint32_t nextTemp = 6;
+        constructSSA(function, nextTemp);
+        check(!touchesVariable(function, 0), "Promoted variables should not be loaded or stored");
+        check(countOf(function, IRInstructionType::PHI) == 1, "The join should get a single phi");
+        check(touchesVariable(function, 2), "Variables used elsewhere should stay in memory");
+
+        const std::vector<IRInstruction>& instructions = function.getInstructions();
+        const IRInstruction& phi = instructions[function.getBlock(3).begin];
+        check(phi.type == IRInstructionType::PHI && function.phiIncoming(phi)[0] == IROperand::temp(1)
+              && function.phiIncoming(phi)[1] == IROperand::temp(2), "The phi should merge the stored values");
+        const IRInstruction& add = instructions[function.getBlock(3).begin + 1];
+        check(add.type == IRInstructionType::ADD && add.src1() == phi.dest() && add.src2() == instructions[0].dest()
+              && instructions[0].src1() == IROperand::variable(1), "Uses should read the reaching values");
+        check(countOf(function, IRInstructionType::LOAD) == 3, "Only the parameter load and the constants should be left");
+
+        destroySSA(function, nextTemp);
+        check(countOf(function, IRInstructionType::PHI) == 0, "SSA destruction should remove the phis");
+        const IRInstruction& last = function.getInstructions()[function.getBlock(2).end - 2];
+        check(last.type == IRInstructionType::LOAD && last.src1() == IROperand::temp(2)
+              && function.getInstructions()[function.getBlock(2).end - 1].type == IRInstructionType::JMP,
+              "Predecessors should copy their value right before the jump");
+        function.buildCFG();
+    }
+
+    // A variable updated in a loop gets a phi at the header
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        load(function, 0, IROperand::immediate(0));
+        store(function, 0, 0);
+        function.jump(1);
+        function.addBlock();           // 1
+        load(function, 1, IROperand::variable(0));
+        load(function, 2, IROperand::immediate(1));
+        function.append(IRInstruction(IRInstructionType::ADD, IROperand::temp(3), IROperand::temp(1), IROperand::temp(2)));
+        store(function, 0, 3);
+        function.branch(IROperand::temp(3), 1, 2);
+        function.addBlock();           // 2
+        ret(function);
+        function.buildCFG();
+        function.setLocalVariables({0});
+
+        uint32_t nextTemp = 4;
+        constructSSA(function, nextTemp);
+        const IRInstruction& phi = function.getInstructions()[function.getBlock(1).begin];
+        check(phi.type == IRInstructionType::PHI && function.phiIncoming(phi)[0] == IROperand::temp(0)
+              && function.phiIncoming(phi)[1] == IROperand::temp(3), "The header phi should merge entry and back edge");
+        check(countOf(function, IRInstructionType::PHI) == 1 && !touchesVariable(function, 0), "One phi should replace the variable");
+    }
+
+    // Generated IR has one function per function and per run of top-level
+    // statements, nested functions included
+    {
+        std::vector<Token> tokens = tokenize("let x = 1\ndef f(a) {\n    let b = a\n    def g() {\n        let c = 2\n    }\n    let d = b\n}\nlet y = x\n");
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        try {
+            ASTNodePtr module = parser.parse();
+            std::ostringstream diagnostics;
+            SemanticAnalyzer(diagnostics).analyze(module);
+            IRGenerator generator;
+            generator.generateIR(module);
+            const std::vector<IRFunction>& functions = generator.getFunctions();
+            check(functions.size() == 4, "Expected an initializer, f, g and another initializer");
+            if (functions.size() == 4) {
+                check(functions[0].isInitializer() && functions[3].isInitializer(), "Top-level runs should be initializers");
+                check(StringInterner::global().lookup(functions[1].getName()) == "f"
+                      && StringInterner::global().lookup(functions[2].getName()) == "g", "Functions should keep their names");
+                check(functions[1].getInstructions().size() == 5 && functions[2].getInstructions().size() == 3,
+                      "Nested functions should not be inlined into the outer one");
+                check(functions[1].getBlockCount() == 1 && functions[1].getInstructions().back().type == IRInstructionType::RET,
+                      "Straight-line functions should be a single block ending in RET");
+                check(functions[1].getLocalVariables().size() == 3 && functions[2].getLocalVariables().size() == 1
+                      && functions[0].getLocalVariables().empty(), "Frame variables should be local to their function");
+
+                // Lets become plain values, only the parameter is loaded
+                IRFunction function = functions[1];
+                uint32_t nextTemp = generator.getTempCounter();
+                constructSSA(function, nextTemp);
+                destroySSA(function, nextTemp);
+                check(function.getInstructions().size() == 2 && countOf(function, IRInstructionType::STORE) == 0,
+                      "Only the parameter load and RET should be left");
+            }
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+    }
+
+    // Literals on the right of ADD, SUB and MUL become immediates, on both
+    // the pointer and the flat AST
+    {
+        std::vector<Token> tokens = tokenize("let x = 7\nlet y = x * 3 + 200 - 1\nlet z = 5 * x / 2\n");
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        try {
+            ASTNodePtr module = parser.parse();
+            std::ostringstream diagnostics;
+            SemanticAnalyzer(diagnostics).analyze(module);
+            IRGenerator generator;
+            generator.generateIR(module);
+            FlatAST flat = FlatAST::build(module);
+            SemanticAnalyzer(diagnostics).analyze(flat);
+            IRGenerator flatGenerator;
+            flatGenerator.generateIR(flat);
+
+            for (const IRGenerator* ir : {&generator, &flatGenerator}) {
+                const std::vector<IRInstruction>& instructions = ir->getFunctions()[0].getInstructions();
+                std::vector<int32_t> immediates;
+                for (const auto& instruction : instructions) {
+                    if (hasImmediateForm(instruction.type) && instruction.src2().isImmediate()) {
+                        immediates.push_back(instruction.src2().getImmediate());
+                    }
+                    if (instruction.type == IRInstructionType::DIV || hasImmediateForm(instruction.type)) {
+                        check(instruction.src1().kind == IROperandKind::Temp, "First operands should stay temporaries");
+                    }
+                    if (instruction.type == IRInstructionType::DIV) {
+                        check(instruction.src2().kind == IROperandKind::Temp, "Divisors should stay temporaries");
+                    }
+                }
+                check(immediates == std::vector<int32_t>{3, 200, 1}, "Right-hand literals should be immediates");
+                check(countOf(ir->getFunctions()[0], IRInstructionType::LOAD) == 5, "Only the other literals should be loaded");
+            }
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+
+        // Immediates use the sign-extended byte forms when they fit
+        IRFunction function;
+        IROperand t0 = IROperand::temp(0);
+        IROperand t1 = IROperand::temp(1);
+        IROperand t2 = IROperand::temp(2);
+        IROperand t3 = IROperand::temp(3);
+        function.append(IRInstruction(IRInstructionType::ADD, t1, t0, IROperand::immediate(5)));
+        function.append(IRInstruction(IRInstructionType::MUL, t2, t1, IROperand::immediate(1000)));
+        function.append(IRInstruction(IRInstructionType::SUB, t3, t2, IROperand::immediate(-1)));
+        function.append(IRInstruction(IRInstructionType::MUL, t0, t3, IROperand::immediate(-2)));
+        function.append(IRInstruction(IRInstructionType::ADD, t0, t0, IROperand::immediate(128)));
+        CodeGenerator code;
+        code.generateCode(function);
+        std::vector<uint8_t> expected{
+            0x8B, 0xC1, 0x83, 0xC0, 0x05,             // mov eax, ecx; add eax, 5
+            0x69, 0xD0, 0xE8, 0x03, 0x00, 0x00,       // imul edx, eax, 1000
+            0x8B, 0xDA, 0x83, 0xEB, 0xFF,             // mov ebx, edx; sub ebx, -1
+            0x6B, 0xCB, 0xFE,                         // imul ecx, ebx, -2
+            0x81, 0xC1, 0x80, 0x00, 0x00, 0x00,       // add ecx, 128
+        };
+        check(code.getCode() == expected, "Arithmetic with immediates should use the immediate encodings");
+    }
+
+    // IR files hold what they were given and are used in place
+    {
+        std::vector<Token> tokens = tokenize("let x = 1\ndef f(a) {\n    let b = a * 3\n    let c = b + x\n}\n");
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        std::string path = temporaryPath();
+        try {
+            ASTNodePtr module = parser.parse();
+            std::ostringstream diagnostics;
+            SemanticAnalyzer(diagnostics).analyze(module);
+            IRGenerator generator;
+            generator.generateIR(module);
+
+            // A function in SSA form, with phis at the join
+            IRFunction diamond;
+            diamond.addBlock();
+            load(diamond, 0, IROperand::variable(0));
+            diamond.branch(IROperand::temp(0), 1, 2);
+            diamond.addBlock();
+            store(diamond, 1, 0);
+            diamond.jump(3);
+            diamond.addBlock();
+            diamond.jump(3);
+            diamond.addBlock();
+            store(diamond, 1, 0);
+            ret(diamond);
+            diamond.buildCFG();
+            diamond.setLocalVariables({1});
+            uint32_t nextTemp = 1;
+            constructSSA(diamond, nextTemp);
+            generator.getFunctions().push_back(diamond);
+
+            IRFileWriter writer;
+            writer.addUnit(generator);
+            writer.addUnit(generator);
+            writer.write(path);
+
+            IRFile file(path);
+            check(file.getUnitCount() == 2, "Both units should be written");
+            const IRFileUnit& unit = file.getUnit(1);
+            const std::vector<IRFunction>& functions = generator.getFunctions();
+            check(unit.functionCount == functions.size() && unit.variableCount == generator.getVariableCount(),
+                  "Units should keep their functions and variables");
+            for (size_t f = 0; f < functions.size() && f < unit.functionCount; f++) {
+                const IRFileFunction& record = file.getFunction(unit, f);
+                const std::vector<IRInstruction>& instructions = functions[f].getInstructions();
+                check(record.instructionCount == instructions.size()
+                      && std::memcmp(file.getInstructions(record), instructions.data(), instructions.size() * sizeof(IRInstruction)) == 0,
+                      "Instruction records should be the instructions themselves");
+                check(file.getString(record.name) == (functions[f].isInitializer() ? "" : StringInterner::global().lookup(functions[f].getName())),
+                      "Function names should be kept");
+                check(record.blockCount == functions[f].getBlockCount(), "Blocks should be kept");
+            }
+            check(file.getVariableName(unit, 0) == "x", "Variable names should be kept");
+
+            const IRFileFunction& record = file.getFunction(unit, 2);
+            const IRFileBlock& join = file.getBlocks(record)[3];
+            check(join.successorCount == 0 && join.predecessorCount == 2 && file.getEdges(join)[0] == 1 && file.getEdges(join)[1] == 2,
+                  "Edges should be kept");
+            IRFunction loaded = file.loadFunction(unit, 2);
+            const IRInstruction& phi = loaded.getInstructions()[loaded.getBlock(3).begin];
+            const IRInstruction& original = diamond.getInstructions()[diamond.getBlock(3).begin];
+            check(phi.type == IRInstructionType::PHI && loaded.phiIncoming(phi)[0] == diamond.phiIncoming(original)[0]
+                  && loaded.phiIncoming(phi)[1] == diamond.phiIncoming(original)[1], "Phis should load with their operands");
+            check(loaded.getBlock(3).predecessors == diamond.getBlock(3).predecessors
+                  && loaded.getLocalVariables() == diamond.getLocalVariables(), "Loaded functions should match");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+
+        // Other versions, truncated files and records naming things that do
+        // not exist are rejected before anything is handed out
+        std::string bytes;
+        {
+            std::ifstream in(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        IRFileHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        // First instruction of the given type, the file holds one of each
+        auto find = [&](IRInstructionType type) {
+            for (uint32_t i = 0; i < header.instructionCount; i++) {
+                size_t offset = header.instructionOffset + i * sizeof(IRInstruction);
+                if (static_cast<IRInstructionType>(bytes[offset]) == type) return offset;
+            }
+            return bytes.size();
+        };
+        bool complete = true;
+        for (IRInstructionType type : {IRInstructionType::LOAD, IRInstructionType::STORE, IRInstructionType::BR, IRInstructionType::PHI}) {
+            complete &= find(type) < bytes.size();
+        }
+        check(complete, "The IR file should hold every instruction damaged below");
+        auto setOperand = [&](std::string& damaged, size_t instruction, unsigned index, uint32_t value) {
+            std::memcpy(&damaged[instruction + offsetof(IRInstruction, operands) + 4 * index], &value, 4);
+        };
+        const std::pair<const char*, std::function<void(std::string&)>> damages[] = {
+            {"Other versions", [&](std::string& damaged) { damaged[offsetof(IRFileHeader, version)]++; }},
+            {"Truncated files", [&](std::string& damaged) { damaged.resize(damaged.size() - 1); }},
+            {"Unknown opcodes", [&](std::string& damaged) { damaged[find(IRInstructionType::LOAD)] = '\xEE'; }},
+            {"Unknown value types", [&](std::string& damaged) { damaged[find(IRInstructionType::LOAD) + 1] = '\x7F'; }},
+            {"Temporaries past the unit's count",
+             [&](std::string& damaged) { setOperand(damaged, find(IRInstructionType::LOAD), 0, 0xFFFFFFFF); }},
+            {"Variables past the unit's count",
+             [&](std::string& damaged) { setOperand(damaged, find(IRInstructionType::STORE), 0, 0x7FFFFFF0); }},
+            {"Branches to missing blocks", [&](std::string& damaged) { setOperand(damaged, find(IRInstructionType::BR), 2, 4); }},
+            {"Phis past the phi operands", [&](std::string& damaged) { setOperand(damaged, find(IRInstructionType::PHI), 2, 0xFFFF); }},
+        };
+        for (const auto& damage : damages) {
+            if (!complete) break;
+            std::string damaged = bytes;
+            damage.second(damaged);
+            std::ofstream(path, std::ios::binary | std::ios::trunc).write(damaged.data(), damaged.size());
+            bool threw = false;
+            try {
+                IRFile file(path);
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            check(threw, std::string(damage.first) + " should be rejected");
+        }
+        std::remove(path.c_str());
+    }
+
+    if (failures) {
+        std::cerr << failures << " IR test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "IR successful!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include "lexer.h"
+#include "charScan.h"
+#include "tokenStream.h"
+#include "threadPool.h"
+#include <unistd.h>
+
+// Every scanning kernel has to produce exactly the scalar token stream
+static bool sameTokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].type != b[i].type || a[i].value.data() != b[i].value.data() || a[i].value.size() != b[i].value.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Junk words are reported as unrecognized, keep them out of the big inputs
+static std::string generateSource(unsigned seed, size_t size = 4096, bool junk = true) {
+    static const char* pieces[] = {
+        "def", "let", "True", "False", "abc", "longVariableName", "x", "42", "1234567890",
+        "(", ")", "{", "}", "=", "+", "-", "*", "/", "// a comment that runs to the end\n",
+        " ", "    ", "\t", "\n", "\r\n", "\v\f", "a1", "1a", "caf\xc3\xa9",
+    };
+    std::mt19937 rng(seed);
+    size_t count = sizeof(pieces) / sizeof(pieces[0]);
+    std::uniform_int_distribution<size_t> pick(0, junk ? count - 1 : count - 4);
+
+    std::string source;
+    while (source.size() < size) {
+        source += pieces[pick(rng)];
+        if (rng() % 16 == 0) source += "ident" + std::string(1, 'a' + rng() % 26) + std::string(1, 'a' + seed % 26) + "\n";
+        if (!junk || rng() % 3 == 0) source += ' ';
+    }
+    return source;
+}
+
+// Fresh file in the temporary directory, removed by the caller
+static std::string temporaryPath() {
+    std::string path = (std::filesystem::temp_directory_path() / "test_lexer_XXXXXX").string();
+    close(mkstemp(&path[0]));
+    return path;
+}
+
+int main() {
+    int failures = 0;
+
+    std::string source = "def main() {\n    let a = 5 // five\n    let b=a*10\n}";
+    std::vector<Token> tokens = tokenize(source);
+    const TokenType expected[] = {
+        Keyword, Identifier, OpenParen, ClosedParen, OpenBracket,
+        Let, Identifier, Equals, Number,
+        Let, Identifier, Equals, Identifier, Multiply, Number,
+        ClosedBracket,
+    };
+    if (tokens.size() != sizeof(expected) / sizeof(expected[0])) {
+        std::cerr << "Unexpected token count " << tokens.size() << std::endl;
+        failures++;
+    } else {
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (tokens[i].type != expected[i]) {
+                std::cerr << "Unexpected type for token " << tokens[i].value << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    const ScanMode modes[] = {ScanMode::SSE2, ScanMode::AVX2};
+    for (unsigned seed = 0; seed < 50; seed++) {
+        std::string source = generateSource(seed);
+        setScanMode(ScanMode::Scalar);
+        std::vector<Token> reference = tokenize(source);
+
+        for (ScanMode mode : modes) {
+            if (!setScanMode(mode)) continue;
+            if (!sameTokens(reference, tokenize(source))) {
+                std::cerr << "Token stream mismatch for mode " << static_cast<int>(mode) << ", seed " << seed << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // Chunk sizes small enough that words, "//" and comments straddle the
+    // chunk boundaries
+    std::string path = temporaryPath();
+    for (unsigned seed = 0; seed < 10; seed++) {
+        std::string source = generateSource(seed);
+        std::ofstream(path, std::ios::binary) << source;
+        std::vector<Token> reference = tokenize(source);
+
+        for (size_t chunkSize : {1, 2, 3, 7, 64}) {
+            ChunkedLexer stream(path, chunkSize);
+            // A window is only valid until the next one is pulled, so compare
+            // as the tokens arrive
+            size_t count = 0;
+            bool same = true;
+            const Token* begin;
+            const Token* end;
+            while (stream.nextWindow(begin, end)) {
+                for (const Token* token = begin; same && token != end; token++, count++) {
+                    same = count < reference.size() && token->type == reference[count].type
+                        && token->value == reference[count].value && token->symbol == reference[count].symbol;
+                }
+            }
+            same &= count == reference.size();
+            if (!same) {
+                std::cerr << "Chunked token stream mismatch for chunk size " << chunkSize << ", seed " << seed << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // Number literals are not interned, streaming distinct numbers leaves
+    // the interner as it was
+    {
+        std::string numbers;
+        for (int i = 0; i < 10000; i++) numbers += "let x = " + std::to_string(1000000 + i) + "\n";
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << numbers;
+        tokenize("x");
+        size_t symbols = StringInterner::global().size();
+
+        ChunkedLexer stream(path, 64);
+        const Token* begin;
+        const Token* end;
+        bool valid = true;
+        int count = 0;
+        while (stream.nextWindow(begin, end)) {
+            for (const Token* token = begin; token != end; token++) {
+                if (token->type != TokenType::Number) continue;
+                valid &= token->value == std::to_string(1000000 + count++);
+            }
+        }
+        if (!valid || count != 10000 || StringInterner::global().size() != symbols) {
+            std::cerr << "Streamed number literals should keep their text without being interned" << std::endl;
+            failures++;
+        }
+    }
+    std::remove(path.c_str());
+
+    // Parallel lexing has to match the serial lexer, including the order in
+    // which new identifiers get their ids
+    ThreadPool pool(4);
+    for (unsigned seed = 0; seed < 3; seed++) {
+        std::string source = generateSource(seed + 100, 4 << 20, false);
+        SymbolId firstNew = static_cast<SymbolId>(StringInterner::global().size());
+        std::vector<Token> parallel = tokenize(source, pool);
+        std::vector<Token> serial = tokenize(source);
+
+        SymbolId expectedNew = firstNew;
+        bool ordered = true;
+        for (const Token& token : parallel) {
+            if (token.symbol != InvalidSymbol && token.symbol >= expectedNew) {
+                ordered &= token.symbol == expectedNew++;
+            }
+        }
+        bool same = parallel.size() == serial.size();
+        for (size_t i = 0; same && i < serial.size(); i++) {
+            same = parallel[i].type == serial[i].type && parallel[i].value.data() == serial[i].value.data()
+                && parallel[i].value.size() == serial[i].value.size() && parallel[i].symbol == serial[i].symbol;
+        }
+        if (!same || !ordered) {
+            std::cerr << "Parallel token stream mismatch for seed " << seed << std::endl;
+            failures++;
+        }
+    }
+
+    if (failures) {
+        std::cerr << failures << " lexer test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Lexer tests passed!" << std::endl;
+    return 0;
+}
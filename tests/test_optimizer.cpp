@@ -0,0 +1,388 @@
+#include <climits>
+#include <stdexcept>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "parser.h"
+#include "semanticAnalyzer.h"
+#include "irGenerator.h"
+#include "ssa.h"
+#include "constantPropagation.h"
+#include "valueNumbering.h"
+#include "deadCodeElimination.h"
+#include "passManager.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static void emit(IRFunction& function, IRInstructionType type, IROperand dest, IROperand src1, IROperand src2 = IROperand()) {
+    function.append(IRInstruction(type, dest, src1, src2));
+}
+
+static void ret(IRFunction& function) {
+    function.append(IRInstruction(IRInstructionType::RET, IROperand(), IROperand(), IROperand(), IRType::Void));
+}
+
+static IROperand t(uint32_t index) { return IROperand::temp(index); }
+static IROperand imm(int32_t value) { return IROperand::immediate(value); }
+
+// The instruction defining temp, or nullptr
+static const IRInstruction* definition(const IRFunction& function, uint32_t temp) {
+    for (const auto& instruction : function.getInstructions()) {
+        if (instruction.type != IRInstructionType::BR && instruction.dest() == IROperand::temp(temp)) return &instruction;
+    }
+    return nullptr;
+}
+
+static bool isConstant(const IRFunction& function, uint32_t temp, int32_t value) {
+    const IRInstruction* instruction = definition(function, temp);
+    return instruction && instruction->type == IRInstructionType::LOAD && instruction->src1() == IROperand::immediate(value);
+}
+
+// Lowers source to IR and runs the passes up to and including SSA form
+static std::vector<IRFunction> lower(const std::string& source, uint32_t& nextTemp) {
+    std::vector<Token> tokens = tokenize(source);
+    ASTArena arena;
+    Parser parser(tokens, arena);
+    ASTNodePtr module = parser.parse();
+    std::ostringstream diagnostics;
+    SemanticAnalyzer(diagnostics).analyze(module);
+    IRGenerator generator;
+    generator.generateIR(module);
+    nextTemp = generator.getTempCounter();
+    std::vector<IRFunction> functions = generator.takeFunctions();
+    for (auto& function : functions) {
+        constructSSA(function, nextTemp);
+    }
+    return functions;
+}
+
+// Analysis for the pass manager tests
+struct BlockCount {
+    size_t blocks;
+};
+
+// Diamond that branches on a value loaded from v0, or on a constant
+static IRFunction diamond(bool constantCondition) {
+    IRFunction function;
+    function.addBlock();
+    emit(function, IRInstructionType::LOAD, t(0), constantCondition ? imm(0) : IROperand::variable(0));
+    function.branch(t(0), 1, 2);
+    function.addBlock();
+    function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(1), t(0)));
+    function.jump(3);
+    function.addBlock();
+    function.jump(3);
+    function.addBlock();
+    ret(function);
+    function.buildCFG();
+    return function;
+}
+
+int main() {
+    // Folding wraps around at 32 bits and leaves trapping divisions alone
+    {
+        IRFunction function;
+        function.addBlock();
+        emit(function, IRInstructionType::LOAD, t(0), imm(INT_MAX));
+        emit(function, IRInstructionType::LOAD, t(1), imm(1));
+        emit(function, IRInstructionType::ADD, t(2), t(0), t(1));
+        emit(function, IRInstructionType::LOAD, t(3), imm(65536));
+        emit(function, IRInstructionType::MUL, t(4), t(3), t(3));
+        emit(function, IRInstructionType::SUB, t(5), t(2), t(1));
+        emit(function, IRInstructionType::LOAD, t(6), imm(0));
+        emit(function, IRInstructionType::DIV, t(7), t(1), t(6));
+        emit(function, IRInstructionType::LOAD, t(8), imm(-1));
+        emit(function, IRInstructionType::DIV, t(9), t(2), t(8));
+        emit(function, IRInstructionType::LOAD, t(10), imm(-7));
+        emit(function, IRInstructionType::LOAD, t(11), imm(2));
+        emit(function, IRInstructionType::DIV, t(12), t(10), t(11));
+        emit(function, IRInstructionType::ADD, t(13), t(7), t(1));
+        ret(function);
+        function.buildCFG();
+
+        size_t folded = propagateConstants(function);
+        check(isConstant(function, 2, INT_MIN), "INT_MAX + 1 should wrap to INT_MIN");
+        check(isConstant(function, 4, 0), "65536 * 65536 should wrap to 0");
+        check(isConstant(function, 5, INT_MAX), "INT_MIN - 1 should wrap to INT_MAX");
+        check(definition(function, 7)->type == IRInstructionType::DIV, "Division by zero should not be folded");
+        check(definition(function, 9)->type == IRInstructionType::DIV, "INT_MIN / -1 should not be folded");
+        check(isConstant(function, 12, -3), "Division should truncate toward zero");
+        check(definition(function, 13)->type == IRInstructionType::ADD, "Results of unfolded divisions are not constant");
+        check(folded == 4, "Four instructions should be folded");
+    }
+
+    // Constant operands become immediates where the instruction has a form
+    // for them
+    {
+        IRFunction function;
+        function.addBlock();
+        emit(function, IRInstructionType::LOAD, t(0), imm(4));
+        emit(function, IRInstructionType::LOAD, t(1), IROperand::variable(0));
+        emit(function, IRInstructionType::MUL, t(2), t(0), t(1));
+        emit(function, IRInstructionType::SUB, t(3), t(0), t(1));
+        emit(function, IRInstructionType::SUB, t(4), t(1), t(0));
+        emit(function, IRInstructionType::DIV, t(5), t(1), t(0));
+        ret(function);
+        function.buildCFG();
+
+        propagateConstants(function);
+        check(definition(function, 2)->src1() == t(1) && definition(function, 2)->src2() == imm(4),
+              "Commutative operations should take the constant second");
+        check(definition(function, 3)->src1() == t(0) && definition(function, 4)->src2() == imm(4),
+              "Subtraction only has an immediate form for its second operand");
+        check(definition(function, 5)->src2() == t(0), "Divisors should stay in registers");
+    }
+
+    // Only the side of a constant branch that runs feeds the phi
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        emit(function, IRInstructionType::LOAD, t(0), imm(1));
+        function.branch(t(0), 1, 2);
+        function.addBlock();           // 1
+        emit(function, IRInstructionType::LOAD, t(1), imm(10));
+        function.jump(3);
+        function.addBlock();           // 2
+        emit(function, IRInstructionType::LOAD, t(2), IROperand::variable(0));
+        function.jump(3);
+        function.addBlock();           // 3
+        function.append(function.makePhi(t(3), IRType::I32, 2));
+        emit(function, IRInstructionType::ADD, t(4), t(3), t(0));
+        ret(function);
+        function.buildCFG();
+        const IRInstruction& phi = function.getInstructions()[function.getBlock(3).begin];
+        function.phiIncoming(phi)[0] = t(1);
+        function.phiIncoming(phi)[1] = t(2);
+
+        propagateConstants(function);
+        check(isConstant(function, 3, 10) && isConstant(function, 4, 11), "The phi should only see the branch taken");
+        check(function.getInstructions()[function.getBlock(0).end - 1].type == IRInstructionType::JMP
+              && function.getBlock(0).successors.size() == 1 && function.getBlock(2).predecessors.empty(),
+              "A constant branch should become a jump");
+    }
+
+    // Values flow through variables, across loops and within blocks
+    {
+        uint32_t nextTemp;
+        std::vector<IRFunction> functions = lower("let g = 6\nlet h = g * 7\ndef f(p) {\n    let a = 5\n    let b = a * 2 - 1\n    let c = b / 0\n    let d = p + b\n}\n", nextTemp);
+        check(functions.size() == 2, "Expected an initializer and f");
+        if (functions.size() == 2) {
+            IRFunction& initializer = functions[0];
+            propagateConstants(initializer);
+            const IRInstruction& store = initializer.getInstructions()[initializer.getInstructions().size() - 1];
+            check(store.type == IRInstructionType::STORE && store.src1() == IROperand::immediate(42),
+                  "Stores to globals should be forwarded within the block");
+
+            IRFunction& f = functions[1];
+            propagateConstants(f);
+            size_t divisions = 0;
+            size_t constants = 0;
+            for (const auto& instruction : f.getInstructions()) {
+                divisions += instruction.type == IRInstructionType::DIV;
+                constants += instruction.type == IRInstructionType::LOAD && instruction.src1() == IROperand::immediate(9);
+            }
+            check(constants == 1 && divisions == 1, "a * 2 - 1 should fold to 9 but b / 0 should stay");
+        }
+    }
+
+    // Unreachable blocks go and the phis after them lose their operands
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        emit(function, IRInstructionType::LOAD, t(0), IROperand::variable(0));
+        function.jump(2);
+        function.addBlock();           // 1, nothing jumps here
+        emit(function, IRInstructionType::LOAD, t(1), imm(1));
+        function.jump(2);
+        function.addBlock();           // 2
+        function.append(function.makePhi(t(2), IRType::I32, 2));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(1), t(2)));
+        ret(function);
+        function.buildCFG();
+        const IRInstruction& phi = function.getInstructions()[function.getBlock(2).begin];
+        function.phiIncoming(phi)[0] = t(0);
+        function.phiIncoming(phi)[1] = t(1);
+
+        DeadCodeStats stats = eliminateDeadCode(function);
+        check(stats.blocks == 1 && stats.instructions == 2, "The unreachable block should be removed");
+        check(function.getBlockCount() == 2 && function.getBlock(1).predecessors == std::vector<BlockId>{0},
+              "Blocks should be renumbered");
+        const IRInstruction& jump = function.getInstructions()[function.getBlock(0).end - 1];
+        check(jump.type == IRInstructionType::JMP && jump.src1().value == 1, "Jumps should follow the renumbering");
+        const IRInstruction& kept = function.getInstructions()[function.getBlock(1).begin];
+        check(kept.type == IRInstructionType::PHI && function.phiIncoming(kept)[0] == t(0),
+              "The phi should keep the operand of the block left");
+    }
+
+    // Dead chains and loop phis feeding only themselves go, side effects stay
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        emit(function, IRInstructionType::LOAD, t(0), imm(1));
+        emit(function, IRInstructionType::LOAD, t(1), IROperand::variable(0));
+        emit(function, IRInstructionType::DIV, t(2), t(1), t(1));
+        emit(function, IRInstructionType::LOAD, t(3), imm(4));
+        emit(function, IRInstructionType::DIV, t(4), t(1), t(3));
+        emit(function, IRInstructionType::MUL, t(5), t(4), t(0));
+        function.jump(1);
+        function.addBlock();           // 1
+        function.append(function.makePhi(t(6), IRType::I32, 2));
+        emit(function, IRInstructionType::ADD, t(7), t(6), t(0));
+        emit(function, IRInstructionType::ZEXT, t(8), t(0));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(1), t(8), IROperand(), IRType::I8));
+        function.branch(t(1), 1, 2);
+        function.addBlock();           // 2
+        ret(function);
+        function.buildCFG();
+        const IRInstruction& phi = function.getInstructions()[function.getBlock(1).begin];
+        function.phiIncoming(phi)[0] = t(0);
+        function.phiIncoming(phi)[1] = t(7);
+
+        DeadCodeStats stats = eliminateDeadCode(function);
+        check(stats.blocks == 0 && stats.instructions == 5, "Five instructions should be dead");
+        check(definition(function, 2) && definition(function, 2)->type == IRInstructionType::DIV,
+              "A division that may trap should stay");
+        check(!definition(function, 4) && !definition(function, 5), "A division by a constant should go with its users");
+        check(!definition(function, 6) && !definition(function, 7), "The loop phi should go");
+        check(definition(function, 8) && definition(function, 0), "Stored values should stay");
+        function.buildCFG();
+        check(function.getBlock(1).successors.size() == 2, "Terminators should stay");
+    }
+
+    // Computations are reused in the blocks their first instance dominates
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        emit(function, IRInstructionType::LOAD, t(0), IROperand::variable(0));
+        emit(function, IRInstructionType::LOAD, t(1), IROperand::variable(1));
+        emit(function, IRInstructionType::MUL, t(2), t(0), t(1));
+        emit(function, IRInstructionType::LOAD, t(3), IROperand::variable(0));
+        emit(function, IRInstructionType::MUL, t(4), t(1), t(3));
+        emit(function, IRInstructionType::SUB, t(5), t(0), t(1));
+        emit(function, IRInstructionType::SUB, t(6), t(1), t(0));
+        function.branch(t(2), 1, 2);
+        function.addBlock();           // 1
+        emit(function, IRInstructionType::ADD, t(7), t(4), t(5));
+        function.jump(3);
+        function.addBlock();           // 2
+        emit(function, IRInstructionType::ADD, t(8), t(5), t(2));
+        emit(function, IRInstructionType::LOAD, t(9), t(8));
+        function.jump(3);
+        function.addBlock();           // 3
+        function.append(function.makePhi(t(10), IRType::I32, 2));
+        function.append(function.makePhi(t(11), IRType::I32, 2));
+        emit(function, IRInstructionType::MUL, t(12), t(1), t(0));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(2), t(12)));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(2), t(10)));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(2), t(11)));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(2), t(6)));
+        ret(function);
+        function.buildCFG();
+        const IRInstruction& first = function.getInstructions()[function.getBlock(3).begin];
+        function.phiIncoming(first)[0] = t(7);
+        function.phiIncoming(first)[1] = t(9);
+        const IRInstruction& second = function.getInstructions()[function.getBlock(3).begin + 1];
+        function.phiIncoming(second)[0] = t(6);
+        function.phiIncoming(second)[1] = t(6);
+
+        size_t replaced = numberValues(function);
+        check(!definition(function, 3) && !definition(function, 4), "a * b and b * a should be one value");
+        check(definition(function, 6) != nullptr, "a - b and b - a are different values");
+        check(definition(function, 7) && definition(function, 8), "Values from sibling blocks are not available");
+        check(!definition(function, 9) && function.phiIncoming(*definition(function, 10))[1] == t(8),
+              "Copies should be forwarded into phis");
+        check(!definition(function, 11) && !definition(function, 12), "Trivial phis and dominated values should go");
+        const std::vector<IRInstruction>& instructions = function.getInstructions();
+        size_t end = instructions.size();
+        check(instructions[end - 5].src1() == t(2) && instructions[end - 3].src1() == t(6) && instructions[end - 2].src1() == t(6),
+              "Uses should read the values kept");
+        check(replaced == 5, "Five instructions should be replaced");
+    }
+
+    // Variables the function stores are only reused up to the next store
+    {
+        IRFunction function;
+        function.addBlock();           // 0
+        emit(function, IRInstructionType::LOAD, t(0), IROperand::variable(0));
+        emit(function, IRInstructionType::LOAD, t(1), IROperand::variable(0));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(0), imm(3)));
+        emit(function, IRInstructionType::LOAD, t(2), IROperand::variable(0));
+        function.jump(1);
+        function.addBlock();           // 1
+        emit(function, IRInstructionType::LOAD, t(3), IROperand::variable(0));
+        emit(function, IRInstructionType::ADD, t(4), t(0), t(1));
+        emit(function, IRInstructionType::ADD, t(5), t(2), t(3));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(0), t(4)));
+        function.append(IRInstruction(IRInstructionType::STORE, IROperand::variable(1), t(5)));
+        ret(function);
+        function.buildCFG();
+
+        numberValues(function);
+        check(!definition(function, 1) && definition(function, 4)->src2() == t(0), "Reloads before a store should go");
+        check(!definition(function, 2) && definition(function, 5)->src1() == imm(3), "Loads after a store read the stored value");
+        check(definition(function, 3) != nullptr, "Loads in another block should stay");
+    }
+
+    // Levels, custom pass lists and what the pass manager counts
+    {
+        check(PassManager::forLevel(0).getPasses().empty(), "-O0 should run no passes");
+        check(PassManager::forLevel(2).getPasses().size() > PassManager::forLevel(1).getPasses().size(),
+              "-O2 should run more passes than -O1");
+        check(PassManager::parse("ssa,sccp").getPasses() == std::vector<std::string>{"ssa", "sccp", "out-of-ssa"},
+              "Leaving SSA form should be appended");
+        bool threw = false;
+        try {
+            PassManager::parse("sccp,unknown");
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        check(threw, "Unknown passes should be rejected");
+
+        for (bool constantCondition : {false, true}) {
+            IRFunction function = diamond(constantCondition);
+            uint32_t nextTemp = 1;
+            PassStatistics stats;
+            PassManager::parse("gvn,sccp,gvn,dce").run(function, nextTemp, stats);
+            size_t expected = constantCondition ? 2 : 1;
+            check(stats.analyses["dominators"] == expected, "Dominators should only be recomputed after the CFG changed");
+            check(stats.passes.size() == 4 && stats.passes[0].instructionsBefore == 6
+                  && stats.passes[3].instructionsAfter == function.getInstructions().size(),
+                  "Instruction counts should follow the function");
+            for (size_t p = 1; p < stats.passes.size(); p++) {
+                check(stats.passes[p].instructionsBefore == stats.passes[p - 1].instructionsAfter && stats.passes[p].runs == 1,
+                      "Each pass should start where the last one ended");
+            }
+            check(stats.passes[3].changes == (constantCondition ? 3 : 0), "Dead code should only be found under a constant");
+        }
+
+        // Registered passes ask for registered analyses, which are kept
+        // until a pass changes the CFG
+        AnalysisManager::registerAnalysis<BlockCount>("block count", true, [](const IRFunction& function, AnalysisManager&) {
+            return std::unique_ptr<BlockCount>(new BlockCount{function.getBlockCount()});
+        });
+        size_t seen = 0;
+        PassManager::registerPass("count-blocks", [&](IRFunction&, AnalysisManager& analyses, uint32_t&) {
+            seen = analyses.get<BlockCount>().blocks;
+            return PassResult();
+        });
+        IRFunction function = diamond(true);
+        uint32_t nextTemp = 1;
+        PassStatistics stats;
+        PassManager::parse("count-blocks,count-blocks,sccp,dce,count-blocks").run(function, nextTemp, stats);
+        check(seen == 3 && stats.analyses["block count"] == 2, "Custom analyses should be cached and invalidated");
+    }
+
+    if (failures) {
+        std::cerr << failures << " optimizer test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Optimization successful!" << std::endl;
+    return 0;
+}
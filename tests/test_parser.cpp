@@ -1,23 +1,337 @@
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
 #include "parser.h"
+#include "incrementalParser.h"
+#include "flatAst.h"
+#include "astPrinter.h"
+#include "irGenerator.h"
+#include "semanticAnalyzer.h"
+#include "threadPool.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "FAILED: " << message << std::endl;
+        failures++;
+    }
+}
+
+static BinaryOperatorNode* asBinary(ASTNodePtr node) {
+    return dynamic_cast<BinaryOperatorNode*>(node);
+}
+
+// Unwraps the first item of the module returned by parse()
+static ASTNodePtr firstItem(ASTNodePtr module) {
+    auto node = dynamic_cast<ModuleNode*>(module);
+    return node && !node->getItems().empty() ? node->getItems()[0] : nullptr;
+}
+
+// Instructions of all functions in order
+static std::vector<IRInstruction> instructions(const IRGenerator& generator) {
+    std::vector<IRInstruction> all;
+    for (const auto& function : generator.getFunctions()) {
+        all.insert(all.end(), function.getInstructions().begin(), function.getInstructions().end());
+    }
+    return all;
+}
+
+static std::vector<IRInstruction> lower(ASTNodePtr module) {
+    SemanticAnalyzer analyzer;
+    analyzer.analyze(module);
+    IRGenerator generator;
+    generator.generateIR(module);
+    return instructions(generator);
+}
+
+static bool sameIR(const std::vector<IRInstruction>& expected, const std::vector<IRInstruction>& actual) {
+    bool same = expected.size() == actual.size();
+    for (size_t i = 0; same && i < expected.size(); i++) {
+        same = expected[i].type == actual[i].type && expected[i].dest() == actual[i].dest()
+            && expected[i].src1() == actual[i].src1() && expected[i].src2() == actual[i].src2()
+            && expected[i].valueType == actual[i].valueType;
+    }
+    return same;
+}
+
+// Identifiers are letters only, so spell numbers with them
+static std::string letters(int value) {
+    std::string name;
+    do {
+        name += static_cast<char>('a' + value % 26);
+        value /= 26;
+    } while (value);
+    return name;
+}
+
+static int numberValue(ASTNodePtr node) {
+    auto number = dynamic_cast<NumberNode*>(node);
+    return number ? number->getValue() : -1;
+}
 
 int main() {
-    std::vector<Token> tokens = {
-            { "3", TokenType::Number },
-            { "+", TokenType::BinaryOperator },
-            { "4", TokenType::Number },
-            { "*", TokenType::BinaryOperator },
-            { "2", TokenType::Number },
-            { "", TokenType::End }
-    };
-
-    Parser parser(tokens);
-    try {
-        ASTNodePtr ast = parser.parse();
-        std::cout << "Parsing successful!" << std::endl;
-    } catch (const std::exception& e) {
-        std::cerr << e.what() << std::endl;
+    // 3 + 4 * 2 binds the multiplication tighter
+    {
+        std::vector<Token> tokens = {
+                { "3", TokenType::Number },
+                { "+", TokenType::Add },
+                { "4", TokenType::Number },
+                { "*", TokenType::Multiply },
+                { "2", TokenType::Number },
+        };
+
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        try {
+            auto root = asBinary(firstItem(parser.parse()));
+            check(root && root->getTokenType() == TokenType::Add, "3 + 4 * 2 should be an addition at the root");
+            check(root && numberValue(root->getLeft()) == 3, "3 + 4 * 2 should have 3 on the left");
+            auto right = root ? asBinary(root->getRight()) : nullptr;
+            check(right && right->getTokenType() == TokenType::Multiply, "3 + 4 * 2 should multiply on the right");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+    }
+
+    // 10 - 4 - 3 is left associative
+    {
+        std::string source = "10 - 4 - 3";
+        std::vector<Token> tokens = tokenize(source);
+
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        auto root = asBinary(firstItem(parser.parse()));
+        check(root && numberValue(root->getRight()) == 3, "10 - 4 - 3 should subtract 3 last");
+        auto left = root ? asBinary(root->getLeft()) : nullptr;
+        check(left && numberValue(left->getLeft()) == 10 && numberValue(left->getRight()) == 4, "10 - 4 - 3 should subtract 4 first");
+    }
+
+    // Machine-generated chains must not grow the C++ stack per operand
+    {
+        std::string source = "a";
+        for (int i = 0; i < 200000; i++) {
+            source += i % 3 ? " + a" : " * (a - 1)";
+        }
+        std::vector<Token> tokens = tokenize(source);
+
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        try {
+            check(asBinary(firstItem(parser.parse())) != nullptr, "Long chain should parse to a binary expression");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+    }
+
+    // Parsing functions on the pool gives the same program as the serial parse
+    {
+        std::string source = "let x = 1\n";
+        for (int i = 0; i < 64; i++) {
+            std::string n = std::to_string(i);
+            std::string name = letters(i);
+            source += "def f" + name + "(a b) {\n    let c" + name + " = a * (b + " + n + ")\n    let d = c" + name + " - 2\n}\n";
+            if (i % 8 == 0) source += "let y" + name + " = x + " + n + "\n";
+        }
+        std::vector<Token> tokens = tokenize(source);
+
+        ASTArena serialArena;
+        ASTArena parallelArena;
+        ThreadPool pool(4);
+        Parser serial(tokens, serialArena);
+        Parser parallel(tokens, parallelArena);
+        try {
+            auto serialModule = dynamic_cast<ModuleNode*>(serial.parse());
+            auto parallelModule = dynamic_cast<ModuleNode*>(parallel.parse(pool));
+            check(serialModule && parallelModule && serialModule->getItems().size() == 73
+                  && parallelModule->getItems().size() == 73, "Module should hold every top-level item");
+
+            check(sameIR(lower(serialModule), lower(parallelModule)), "Parallel parse should lower to the same IR as the serial parse");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+    }
+
+    // Errors inside a function are still reported by the parallel parse
+    {
+        std::vector<Token> tokens = tokenize("def f(a) { let b = a }\ndef g(a) { let = }\ndef h(a) { let c = a }\n");
+        ASTArena arena;
+        ThreadPool pool(2);
+        Parser parser(tokens, arena);
+        bool threw = false;
+        try {
+            parser.parse(pool);
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(threw, "Parallel parse should report errors inside functions");
     }
 
+    // Dumps number nodes in the order they are reached
+    {
+        std::vector<Token> tokens = tokenize("let a = b + 2");
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        ASTNodePtr module = parser.parse();
+
+        std::ostringstream json;
+        ASTPrinter(json).writeJson(module);
+        check(json.str() == "{\"id\":0,\"kind\":\"Module\",\"children\":[{\"id\":1,\"kind\":\"VariableDeclaration\",\"children\":["
+                            "{\"id\":2,\"kind\":\"Identifier\",\"name\":\"a\"},{\"id\":3,\"kind\":\"BinaryExpression\",\"operator\":\"Add\",\"children\":["
+                            "{\"id\":4,\"kind\":\"Identifier\",\"name\":\"b\"},{\"id\":5,\"kind\":\"Number\",\"value\":2}]}]}]}\n",
+              "JSON dump should match");
+
+        std::ostringstream dot;
+        ASTPrinter(dot).writeDot(module);
+        check(dot.str().find("node3 [label=\"Add\"];\nnode3 -> node4;\nnode3 -> node5;\n") != std::string::npos,
+              "DOT dump should number nodes as it goes");
+    }
+
+    // The flat AST lowers to the same IR as the pointer tree
+    {
+        std::string source = "let x = 1\nlet t = True\nx = 3\nlet u = t + x\n";
+        for (int i = 0; i < 10; i++) {
+            source += "def f" + letters(i) + "(a b) {\n    let c = a * (b + " + std::to_string(i) + ") - x / 2\n    let d = c\n}\n";
+        }
+        std::vector<Token> tokens = tokenize(source);
+
+        ASTArena arena;
+        Parser parser(tokens, arena);
+        try {
+            ASTNodePtr module = parser.parse();
+            FlatAST flat = FlatAST::build(module);
+            check(flat.kind(flat.root()) == ASTNodeType::Module && flat.size() == 1 + 14 + 10 * 17,
+                  "Flat AST should hold one entry per node");
+
+            SemanticAnalyzer analyzer;
+            analyzer.analyze(flat);
+            IRGenerator generator;
+            generator.generateIR(flat);
+            check(sameIR(lower(module), instructions(generator)), "Flat AST should lower to the same IR");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+    }
+
+    // Lazy bodies are parsed on first use and give the same program
+    {
+        std::string source = "let x = 1\n";
+        for (int i = 0; i < 10; i++) {
+            source += "def f" + letters(i) + "(a b) {\n    let c = a * (b + " + std::to_string(i) + ")\n}\n";
+        }
+        std::vector<Token> tokens = tokenize(source);
+
+        ASTArena eagerArena;
+        Parser eager(tokens, eagerArena);
+        ASTArena lazyArena;
+        LazyBodyParser bodies(lazyArena);
+        Parser lazy(tokens, lazyArena);
+        lazy.setLazyBodies(&bodies);
+        try {
+            ASTNodePtr module = lazy.parse();
+            auto function = dynamic_cast<FunctionNode*>(dynamic_cast<ModuleNode*>(module)->getItems()[1]);
+            check(function && !function->isBodyParsed() && bodies.getParsedCount() == 0, "Lazy parse should skip bodies");
+            check(sameIR(lower(eager.parse()), lower(module)), "Lazy bodies should lower to the same IR as eager ones");
+            check(function && function->isBodyParsed() && bodies.getParsedCount() == 10, "Bodies should be parsed once on demand");
+        } catch (const std::exception& e) {
+            check(false, e.what());
+        }
+
+        std::vector<Token> broken = tokenize("def f(a) { let = }");
+        Parser brokenParser(broken, lazyArena);
+        brokenParser.setLazyBodies(&bodies);
+        bool threw = false;
+        try {
+            lower(brokenParser.parse());
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(threw, "Errors in a lazy body should be reported when it is parsed");
+    }
+
+    // Editing one function reparses only that function
+    {
+        std::string source = "let x = 1\n";
+        for (int i = 0; i < 20; i++) {
+            source += "def f" + letters(i) + "(a b) {\n    let c = a * b\n}\n";
+        }
+
+        IncrementalParser incremental;
+        ModuleNode* before = incremental.update(source);
+        check(incremental.getDirtyFunctions().size() == 20, "First update should parse every function");
+
+        size_t offset = source.find("def fk");
+        source.replace(source.find("a * b", offset), 5, "a - b + 2");
+        ModuleNode* after = incremental.update(source);
+        check(incremental.getDirtyFunctions().size() == 1
+              && incremental.getDirtyFunctions()[0]->getName() == "fk", "Only the edited function should be dirty");
+
+        bool reused = before->getItems().size() == after->getItems().size();
+        for (size_t i = 0; reused && i < after->getItems().size(); i++) {
+            reused = before->getItems()[i] == after->getItems()[i] || after->getItems()[i] == incremental.getDirtyFunctions()[0];
+        }
+        check(reused, "Unchanged functions should keep their nodes");
+
+        incremental.update(source);
+        check(incremental.getDirtyFunctions().empty(), "An unchanged source should reparse nothing");
+    }
+
+    // Random edits give the same program as parsing from scratch, or fail
+    // just like it does
+    {
+        const char* inserts[] = { " + b ", " 7 ", "\n", " // ", " } ", " ( ", " let y = 3\n", "def fz(a) { let q = a }\n" };
+        std::mt19937 random(7);
+        std::string source = "let x = 1\n";
+        for (int i = 0; i < 30; i++) {
+            source += "def f" + letters(i) + "(a b) {\n    let c = a * (b + " + std::to_string(i) + ") // scale\n}\n";
+        }
+
+        IncrementalParser incremental;
+        int mismatches = 0;
+        for (int step = 0; step < 300; step++) {
+            std::string edited = source;
+            size_t offset = random() % (edited.size() + 1);
+            if (random() % 2) {
+                edited.insert(offset, inserts[random() % 8]);
+            } else {
+                edited.erase(offset, random() % 4);
+            }
+
+            std::vector<IRInstruction> expected;
+            bool expectedError = false;
+            std::vector<Token> tokens = tokenize(edited);
+            ASTArena arena;
+            Parser parser(tokens, arena);
+            try {
+                expected = lower(parser.parse());
+            } catch (const std::exception&) {
+                expectedError = true;
+            }
+
+            std::vector<IRInstruction> actual;
+            bool actualError = false;
+            try {
+                actual = lower(incremental.update(edited));
+            } catch (const std::exception&) {
+                actualError = true;
+            }
+
+            if (expectedError != actualError || (!expectedError && !sameIR(expected, actual))) {
+                mismatches++;
+            }
+            // Keep building on edits that still parse
+            if (!expectedError) {
+                source = edited;
+            }
+        }
+        check(mismatches == 0, "Incremental parse should match a full parse after every edit");
+    }
+
+    if (failures) {
+        std::cerr << failures << " parser test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Parsing successful!" << std::endl;
     return 0;
-}
\ No newline at end of file
+}